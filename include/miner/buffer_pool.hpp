@@ -0,0 +1,80 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINER_BUFFER_POOL_HPP
+#define MINER_BUFFER_POOL_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+namespace miner {
+
+    /**
+     * Implements a pool of write buffers. A buffer is free again once the
+     * pool holds the only reference to it (all of the writes that shared it
+     * have completed) so it's capacity is reused without allocating.
+     * @note Not thread safe, acquire from a single strand.
+     */
+    class buffer_pool
+    {
+        public:
+        
+            /**
+             * The maximum number of buffers retained.
+             */
+            enum { max_buffers = 64 };
+        
+            /**
+             * The capacity each buffer is allocated with.
+             */
+            enum { buffer_capacity = 256 };
+        
+            /**
+             * Constructor
+             */
+            buffer_pool();
+        
+            /**
+             * Acquires a (cleared) buffer.
+             */
+            std::shared_ptr<std::string> acquire();
+        
+        private:
+        
+            /**
+             * The buffers.
+             */
+            std::vector< std::shared_ptr<std::string> > buffers_;
+        
+            /**
+             * The index to start the search for a free buffer at.
+             */
+            std::size_t index_;
+        
+        protected:
+        
+            // ...
+    };
+    
+} // namespace miner
+
+#endif // MINER_BUFFER_POOL_HPP
@@ -21,6 +21,7 @@
 #ifndef MINER_CONFIGURATION_HPP
 #define MINER_CONFIGURATION_HPP
 
+#include <atomic>
 #include <cstdint>
 #include <string>
 #include <vector>
@@ -64,6 +65,24 @@ namespace miner {
                 proof_of_work_type_whirlpool_xor,
             } proof_of_work_type_t;
         
+            /**
+             * The pool selection types.
+             */
+            typedef enum pool_selection_s
+            {
+                pool_selection_order,
+                pool_selection_latency,
+            } pool_selection_t;
+        
+            /**
+             * The work host protocols.
+             */
+            typedef enum work_host_protocol_s
+            {
+                work_host_protocol_stratum,
+                work_host_protocol_stratum_v2,
+            } work_host_protocol_t;
+        
             /**
              * Set the device type.
              * @param val The value.
@@ -99,6 +118,11 @@ namespace miner {
                 std::pair<std::string, std::uint16_t> >
             > & work_hosts();
         
+            /**
+             * The protocols of the work hosts (by work host index).
+             */
+            std::vector<work_host_protocol_t> & work_host_protocols();
+        
             /**
              * Sets the device cores.
              * @param val The value.
@@ -108,7 +132,182 @@ namespace miner {
             /**
              * The number of device cores.
              */
-            const std::uint32_t & device_cores() const;
+            std::uint32_t device_cores() const;
+        
+            /**
+             * Sets the throttle target hashes per second (zero is none).
+             * @param val The value.
+             */
+            void set_throttle_hashes_per_second(const double & val);
+        
+            /**
+             * The throttle target hashes per second (zero is none).
+             */
+            const double & throttle_hashes_per_second() const;
+        
+            /**
+             * Sets the throttle target percent of (all) CPU time (zero is
+             * none).
+             * @param val The value.
+             */
+            void set_throttle_cpu_percent(const double & val);
+        
+            /**
+             * The throttle target percent of (all) CPU time (zero is none).
+             */
+            const double & throttle_cpu_percent() const;
+        
+            /**
+             * Sets the throttle load average ceiling (zero is none).
+             * @param val The value.
+             */
+            void set_throttle_load_average(const double & val);
+        
+            /**
+             * The throttle load average ceiling (zero is none).
+             */
+            const double & throttle_load_average() const;
+        
+            /**
+             * Sets if the CPU's should run under SCHED_IDLE.
+             * @param val The value.
+             */
+            void set_sched_idle(const bool & val);
+        
+            /**
+             * If true the CPU's run under SCHED_IDLE.
+             */
+            const bool & sched_idle() const;
+        
+            /**
+             * Sets the throttle temperature ceiling in degrees Celsius (zero
+             * is none).
+             * @param val The value.
+             */
+            void set_throttle_temperature(const double & val);
+        
+            /**
+             * The throttle temperature ceiling in degrees Celsius (zero is
+             * none).
+             */
+            const double & throttle_temperature() const;
+        
+            /**
+             * Sets the throttle power ceiling in watts (zero is none).
+             * @param val The value.
+             */
+            void set_throttle_watts(const double & val);
+        
+            /**
+             * The throttle power ceiling in watts (zero is none).
+             */
+            const double & throttle_watts() const;
+        
+            /**
+             * Sets the sysfs root.
+             * @param val The value.
+             */
+            void set_sysfs_root(const std::string & val);
+        
+            /**
+             * The sysfs root.
+             */
+            const std::string & sysfs_root() const;
+        
+            /**
+             * Sets the number of io_service threads.
+             * @param val The value.
+             */
+            void set_io_threads(const std::uint32_t & val);
+        
+            /**
+             * The number of io_service threads.
+             */
+            const std::uint32_t & io_threads() const;
+        
+            /**
+             * Sets the cores the io_service threads are pinned to.
+             * @param val The value.
+             */
+            void set_io_cores(const std::vector<std::uint32_t> & val);
+        
+            /**
+             * The cores the io_service threads are pinned to (empty is none).
+             */
+            const std::vector<std::uint32_t> & io_cores() const;
+        
+            /**
+             * Sets the number of backup pools kept connected.
+             * @param val The value.
+             */
+            void set_backup_pools(const std::uint32_t & val);
+        
+            /**
+             * The number of backup pools kept connected (subscribed,
+             * authorized and with their latest work cached).
+             */
+            const std::uint32_t & backup_pools() const;
+        
+            /**
+             * Sets the pool selection.
+             * @param val The value.
+             */
+            void set_pool_selection(const pool_selection_t & val);
+        
+            /**
+             * The pool selection (the order of the work hosts or the measured
+             * latency).
+             */
+            const pool_selection_t & pool_selection() const;
+        
+            /**
+             * Sets the work host weights.
+             * @param val The value.
+             */
+            void set_work_host_weights(const std::vector<double> & val);
+        
+            /**
+             * The work host weights (by work host index), if more than one
+             * is positive hashing is split across those work hosts.
+             */
+            const std::vector<double> & work_host_weights() const;
+        
+            /**
+             * Sets the proxy port.
+             * @param val The value.
+             */
+            void set_proxy_port(const std::uint16_t & val);
+        
+            /**
+             * The port of the (stratum) proxy server downstream miners
+             * connect to (zero is disabled).
+             */
+            const std::uint16_t & proxy_port() const;
+        
+            /**
+             * Sets the proxy address.
+             * @param val The value.
+             */
+            void set_proxy_address(const std::string & val);
+        
+            /**
+             * The address the (stratum) proxy server listens on (the
+             * loopback by default since downstream miners are not
+             * authenticated).
+             */
+            const std::string & proxy_address() const;
+        
+            /**
+             * Sets the share rate.
+             * @param val The value.
+             */
+            void set_share_rate(const double & val);
+        
+            /**
+             * The share rate (per minute) the difficulty suggested to the
+             * work hosts aims for (zero is disabled).
+             */
+            const double & share_rate() const;
         
         private:
         
@@ -136,9 +335,90 @@ namespace miner {
             > m_work_hosts;
         
             /**
-             * The number of device cores.
+             * The work host protocols.
+             */
+            std::vector<work_host_protocol_t> m_work_host_protocols;
+        
+            /**
+             * The number of device cores (set at runtime by the stack and
+             * read by the cpu_manager).
+             */
+            std::atomic<std::uint32_t> m_device_cores;
+        
+            /**
+             * The throttle target hashes per second.
+             */
+            double m_throttle_hashes_per_second;
+        
+            /**
+             * The throttle target percent of CPU time.
+             */
+            double m_throttle_cpu_percent;
+        
+            /**
+             * The throttle load average ceiling.
+             */
+            double m_throttle_load_average;
+        
+            /**
+             * If true the CPU's run under SCHED_IDLE.
+             */
+            bool m_sched_idle;
+        
+            /**
+             * The throttle temperature ceiling.
+             */
+            double m_throttle_temperature;
+        
+            /**
+             * The throttle power ceiling.
+             */
+            double m_throttle_watts;
+        
+            /**
+             * The sysfs root.
+             */
+            std::string m_sysfs_root;
+        
+            /**
+             * The number of io_service threads.
+             */
+            std::uint32_t m_io_threads;
+        
+            /**
+             * The cores the io_service threads are pinned to.
+             */
+            std::vector<std::uint32_t> m_io_cores;
+        
+            /**
+             * The number of backup pools kept connected.
+             */
+            std::uint32_t m_backup_pools;
+        
+            /**
+             * The pool selection.
+             */
+            pool_selection_t m_pool_selection;
+        
+            /**
+             * The work host weights.
+             */
+            std::vector<double> m_work_host_weights;
+        
+            /**
+             * The proxy port.
+             */
+            std::uint16_t m_proxy_port;
+        
+            /**
+             * The proxy address.
+             */
+            std::string m_proxy_address;
+        
+            /**
+             * The share rate (per minute).
              */
-            std::uint32_t m_device_cores;
+            double m_share_rate;
         
         protected:
         
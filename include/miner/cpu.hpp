@@ -21,7 +21,10 @@
 #ifndef MINER_CPU_HPP
 #define MINER_CPU_HPP
 
+#include <atomic>
+#include <condition_variable>
 #include <cstdint>
+#include <deque>
 #include <memory>
 #include <mutex>
 #include <thread>
@@ -67,6 +70,20 @@ namespace miner {
              */
             void set_work(const std::shared_ptr<stratum_work> & val);
         
+            /**
+             * Sets the id and maximum id (the nonce range) restarting the
+             * current work if they changed.
+             * @param id The id.
+             * @param id_max The maximum id.
+             */
+            void set_id(const std::uint32_t & id, const std::uint32_t & id_max);
+        
+            /**
+             * Sets the duty cycle (the fraction of time spent hashing).
+             * @param val The value.
+             */
+            void set_duty_cycle(const double & val);
+        
             /**
              * The number of hashes per second.
              */
@@ -115,6 +132,11 @@ namespace miner {
              */
             std::uint64_t m_hash_counter;
         
+            /**
+             * The duty cycle (the fraction of time spent hashing).
+             */
+            std::atomic<double> m_duty_cycle;
+        
         protected:
         
             /**
@@ -142,6 +164,17 @@ namespace miner {
              */
             std::mutex mutex_work_;
         
+            /**
+             * The work std::condition_variable (signaled when the work or
+             * state changes).
+             */
+            std::condition_variable condition_variable_work_;
+        
+            /**
+             * The work epoch (incremented each time the work is set).
+             */
+            std::uint64_t work_epoch_;
+        
             /**
              * If true we have new work.
              */
@@ -151,6 +184,28 @@ namespace miner {
              * If true we ned a work restart.
              */
             bool needs_work_restart_;
+        
+            /**
+             * The nonce progress of a block header.
+             */
+            typedef struct nonce_progress_s
+            {
+                std::vector<std::uint32_t> header;
+                std::uint32_t nonce;
+            } nonce_progress_t;
+        
+            /**
+             * The nonce progress of the recent block headers (only used by
+             * the thread loop) so a re-delivered job resumes where it left
+             * off instead of hashing the same nonces again.
+             */
+            std::deque<nonce_progress_t> nonce_progress_;
+        
+            /**
+             * The maximum number of block headers to keep the nonce
+             * progress of.
+             */
+            enum { max_nonce_progress = 8 };
     };
     
 } // namespace miner
@@ -21,13 +21,20 @@
 #ifndef MINER_CPU_MANAGER_HPP
 #define MINER_CPU_MANAGER_HPP
 
+#include <chrono>
 #include <cstdint>
+#include <map>
 #include <memory>
+#include <mutex>
+#include <thread>
 #include <vector>
 
+#include <boost/asio.hpp>
+
 namespace miner {
 
     class cpu;
+    class governor;
     class stack_impl;
     class stratum_work;
     
@@ -60,29 +67,132 @@ namespace miner {
              */
             void set_work(const std::shared_ptr<stratum_work> & val);
         
+            /**
+             * Sets the work of multiple work hosts, each CPU is assigned the
+             * work of a work host by weight.
+             * @param val The value.
+             */
+            void set_works(
+                const std::map<std::uint32_t,
+                std::shared_ptr<stratum_work> > & val
+            );
+        
+            /**
+             * Grows or shrinks the number of CPU's at runtime, new CPU's
+             * start hashing the current work and removed CPU's are drained.
+             * @param val The value.
+             */
+            void set_device_cores(const std::uint32_t & val);
+        
+            /**
+             * The number of (running) device cores.
+             */
+            std::uint32_t device_cores();
+        
             /**
              * The CPU's.
+             * @note The vector may be resized by the io_service thread, use
+             * hashes_per_second from other threads.
              */
             const std::vector< std::shared_ptr<cpu> > & cpus() const;
         
+            /**
+             * The (combined) number of hashes per second of all CPU's.
+             */
+            double hashes_per_second();
+        
+            /**
+             * The number of CPU's the process may run on taking into account
+             * the scheduler affinity (cpuset) and any cgroup (v1 or v2) CPU
+             * bandwidth quota.
+             */
+            static std::uint32_t available_cores();
+        
         private:
         
+            /**
+             * Calculates the number of device cores to use.
+             */
+            std::uint32_t calculate_device_cores();
+        
+            /**
+             * The timer handler (re-checks the CPU budget).
+             * @param ec The boost::system::error_code.
+             */
+            void tick(const boost::system::error_code & ec);
+        
+            /**
+             * The throttle timer handler (samples the governor and adjusts
+             * the duty cycle towards the configured throttle targets).
+             * @param ec The boost::system::error_code.
+             */
+            void tick_throttle(const boost::system::error_code & ec);
+        
             /**
              * The work.
              */
             std::shared_ptr<stratum_work> m_work;
         
+            /**
+             * The work by work host index (when hashing is split).
+             */
+            std::map<std::uint32_t, std::shared_ptr<stratum_work> > m_works;
+        
             /**
              * The CPU's.
              */
             std::vector< std::shared_ptr<cpu> > m_cpus;
         
+            /**
+             * The governor.
+             */
+            std::shared_ptr<governor> m_governor;
+        
+            /**
+             * The duty cycle (the fraction of time the CPU's spend hashing).
+             */
+            double m_duty_cycle;
+        
+            /**
+             * The total (system) CPU time at the last throttle tick.
+             */
+            std::uint64_t m_cpu_time_total;
+        
+            /**
+             * The process CPU time at the last throttle tick.
+             */
+            std::uint64_t m_cpu_time_process;
+        
         protected:
         
             /**
              * The stack_impl.
              */
             stack_impl & stack_impl_;
+        
+            /**
+             * The std::mutex.
+             */
+            std::mutex mutex_;
+        
+            /**
+             * The threads stopping the removed CPU's.
+             */
+            std::vector<std::thread> threads_stop_;
+        
+            /**
+             * The timer.
+             */
+            boost::asio::basic_waitable_timer<
+                std::chrono::steady_clock
+            > timer_;
+        
+            /**
+             * The throttle timer.
+             */
+            boost::asio::basic_waitable_timer<
+                std::chrono::steady_clock
+            > timer_throttle_;
     };
     
 } // namespace miner
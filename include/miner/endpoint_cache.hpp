@@ -0,0 +1,117 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINER_ENDPOINT_CACHE_HPP
+#define MINER_ENDPOINT_CACHE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace miner {
+
+    /**
+     * Implements a cache of resolved endpoints by host and port so that
+     * reconnects do not wait on DNS.
+     * @note The system resolver does not expose the record TTL so entries
+     * expire after a fixed lifetime or when none of their endpoints connect.
+     */
+    class endpoint_cache
+    {
+        public:
+        
+            /**
+             * The lifetime of an entry in seconds.
+             */
+            enum { ttl = 300 };
+        
+            /**
+             * Constructor
+             */
+            endpoint_cache();
+        
+            /**
+             * The singleton accessor.
+             */
+            static endpoint_cache & instance();
+        
+            /**
+             * Finds the (unexpired) endpoints of a host.
+             * @param host The host.
+             * @param port The port.
+             * @param val The value.
+             */
+            bool find(
+                const std::string & host, const std::uint16_t & port,
+                std::vector<boost::asio::ip::tcp::endpoint> & val
+            );
+        
+            /**
+             * Inserts the endpoints of a host.
+             * @param host The host.
+             * @param port The port.
+             * @param val The value.
+             */
+            void insert(
+                const std::string & host, const std::uint16_t & port,
+                const std::vector<boost::asio::ip::tcp::endpoint> & val
+            );
+        
+            /**
+             * Erases the endpoints of a host.
+             * @param host The host.
+             * @param port The port.
+             */
+            void erase(const std::string & host, const std::uint16_t & port);
+        
+        private:
+        
+            /**
+             * An entry.
+             */
+            typedef struct entry_s
+            {
+                std::vector<boost::asio::ip::tcp::endpoint> endpoints;
+                std::chrono::steady_clock::time_point time_expires;
+            } entry_t;
+        
+            /**
+             * The entries by host:port.
+             */
+            std::map<std::string, entry_t> entries_;
+        
+            /**
+             * The entries std::mutex.
+             */
+            std::mutex mutex_entries_;
+        
+        protected:
+        
+            // ...
+    };
+
+} // namespace miner
+
+#endif // MINER_ENDPOINT_CACHE_HPP
@@ -0,0 +1,104 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINER_GOVERNOR_HPP
+#define MINER_GOVERNOR_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <string>
+
+namespace miner {
+
+    /**
+     * Implements a thermal and power governor (reads the thermal zones and
+     * RAPL energy counters from sysfs).
+     */
+    class governor
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param sysfs_root The sysfs root (usually /sys).
+             */
+            explicit governor(const std::string & sysfs_root);
+        
+            /**
+             * Samples the sensors.
+             */
+            void sample();
+        
+            /**
+             * The highest temperature (in degrees Celsius) of all thermal
+             * zones or zero if unavailable.
+             */
+            const double & temperature() const;
+        
+            /**
+             * The power (in watts) of all RAPL packages since the previous
+             * sample or zero if unavailable.
+             */
+            const double & watts() const;
+        
+        private:
+        
+            /**
+             * Reads an unsigned integer from a file.
+             * @param path The path.
+             * @param val The value.
+             */
+            static bool read(const std::string & path, std::uint64_t & val);
+        
+            /**
+             * The sysfs root.
+             */
+            std::string m_sysfs_root;
+        
+            /**
+             * The temperature.
+             */
+            double m_temperature;
+        
+            /**
+             * The power.
+             */
+            double m_watts;
+        
+            /**
+             * The energy (in microjoules) of each RAPL package at the
+             * previous sample.
+             */
+            std::map<std::string, std::uint64_t> m_energy;
+        
+            /**
+             * The time of the previous sample.
+             */
+            std::chrono::steady_clock::time_point m_time;
+        
+        protected:
+        
+            // ...
+    };
+    
+} // namespace miner
+
+#endif // MINER_GOVERNOR_HPP
@@ -21,6 +21,7 @@
 #ifndef MINER_GPU_HPP
 #define MINER_GPU_HPP
 
+#include <condition_variable>
 #include <cstdint>
 #include <memory>
 #include <mutex>
@@ -141,6 +142,17 @@ namespace miner {
              */
             std::mutex mutex_work_;
         
+            /**
+             * The work std::condition_variable (signaled when the work or
+             * state changes).
+             */
+            std::condition_variable condition_variable_work_;
+        
+            /**
+             * The work epoch (incremented each time the work is set).
+             */
+            std::uint64_t work_epoch_;
+        
             /**
              * If true we have new work.
              */
@@ -0,0 +1,190 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINER_HANDLER_ALLOCATOR_HPP
+#define MINER_HANDLER_ALLOCATOR_HPP
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace miner {
+
+    /**
+     * Implements a single block of memory that is reused by an asynchronous
+     * operation that is only ever outstanding once at a time (e.g. a
+     * socket read) so that it's handler is not allocated on each call.
+     */
+    class handler_allocator
+    {
+        public:
+        
+            /**
+             * Constructor
+             */
+            handler_allocator()
+                : in_use_(false)
+            {
+                // ...
+            }
+        
+            /**
+             * Allocates memory, falling back to the heap if the block is
+             * in use or too small.
+             * @param size The size.
+             */
+            void * allocate(const std::size_t & size)
+            {
+                if (in_use_ == false && size <= sizeof(storage_))
+                {
+                    in_use_ = true;
+                    
+                    return &storage_;
+                }
+                
+                return ::operator new(size);
+            }
+        
+            /**
+             * Deallocates memory.
+             * @param ptr The pointer.
+             */
+            void deallocate(void * ptr)
+            {
+                if (ptr == &storage_)
+                {
+                    in_use_ = false;
+                }
+                else
+                {
+                    ::operator delete(ptr);
+                }
+            }
+        
+        private:
+        
+            /**
+             * Copy constructor
+             */
+            handler_allocator(const handler_allocator &);
+        
+            /**
+             * operator=
+             */
+            handler_allocator & operator=(const handler_allocator &);
+        
+            /**
+             * The storage.
+             */
+            std::aligned_storage<1024>::type storage_;
+        
+            /**
+             * If true the storage is in use.
+             */
+            bool in_use_;
+        
+        protected:
+        
+            // ...
+    };
+
+    /**
+     * Implements a handler that allocates from a handler_allocator.
+     */
+    template <typename Handler>
+    class allocator_handler
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param allocator The handler_allocator.
+             * @param handler The handler.
+             */
+            allocator_handler(handler_allocator & allocator, Handler handler)
+                : allocator_(allocator)
+                , handler_(handler)
+            {
+                // ...
+            }
+        
+            /**
+             * Invokes the handler.
+             */
+            template <typename... Args>
+            void operator()(Args &&... args)
+            {
+                handler_(std::forward<Args> (args)...);
+            }
+        
+            /**
+             * The boost::asio allocation hook.
+             */
+            friend void * asio_handler_allocate(
+                std::size_t size, allocator_handler<Handler> * this_handler
+                )
+            {
+                return this_handler->allocator_.allocate(size);
+            }
+        
+            /**
+             * The boost::asio deallocation hook.
+             */
+            friend void asio_handler_deallocate(
+                void * ptr, std::size_t, allocator_handler<Handler> * this_handler
+                )
+            {
+                this_handler->allocator_.deallocate(ptr);
+            }
+        
+        private:
+        
+            /**
+             * The handler_allocator.
+             */
+            handler_allocator & allocator_;
+        
+            /**
+             * The handler.
+             */
+            Handler handler_;
+        
+        protected:
+        
+            // ...
+    };
+
+    /**
+     * Makes an allocator_handler.
+     * @param allocator The handler_allocator.
+     * @param handler The handler.
+     */
+    template <typename Handler>
+    inline allocator_handler<Handler> make_allocator_handler(
+        handler_allocator & allocator, Handler handler
+        )
+    {
+        return allocator_handler<Handler> (allocator, handler);
+    }
+
+} // namespace miner
+
+#endif // MINER_HANDLER_ALLOCATOR_HPP
@@ -91,7 +91,7 @@ namespace miner {
 			void send_test_work();
 
             /**
-             * The boost::asio::strand.
+             * The boost::asio::strand (shared with the serial_port).
              */
             boost::asio::strand strand_;
         
@@ -22,6 +22,7 @@
 #define MINER_SERIAL_MANAGER_HPP
 
 #include <cstdint>
+#include <map>
 #include <memory>
 #include <vector>
 
@@ -57,6 +58,16 @@ namespace miner {
              */
             void set_work(const std::shared_ptr<stratum_work> & val);
         
+            /**
+             * Sets the work of multiple work hosts, each serial port is
+             * assigned the work of a work host by weight.
+             * @param val The value.
+             */
+            void set_works(
+                const std::map<std::uint32_t,
+                std::shared_ptr<stratum_work> > & val
+            );
+        
             /**
              * The serial_port object's.
              */
@@ -91,6 +91,11 @@ namespace miner {
              */
             boost::asio::io_service & io_service();
         
+            /**
+             * The boost::asio::strand (serializes all handlers of this port).
+             */
+            boost::asio::strand & strand();
+        
             /**
              * Returns a copy of thw work.
              */
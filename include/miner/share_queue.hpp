@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINER_SHARE_QUEUE_HPP
+#define MINER_SHARE_QUEUE_HPP
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace miner {
+
+    /**
+     * Implements a bounded lock-free multiple producer single consumer queue
+     * of (fixed-size) share records. The hashing threads push and the
+     * io_service thread pops.
+     */
+    class share_queue
+    {
+        public:
+        
+            /**
+             * The maximum extranonce2 size (of a share).
+             */
+            enum { max_extranonce2_size = 16 };
+        
+            /**
+             * The share.
+             */
+            typedef struct share_s
+            {
+                std::uint32_t job_handle;
+                std::uint8_t extranonce2[max_extranonce2_size];
+                std::uint8_t extranonce2_size;
+                std::uint8_t time[4];
+                std::uint32_t nonce;
+                std::uint32_t version;
+            } share_t;
+        
+            /**
+             * The capacity (must be a power of two).
+             */
+            enum { capacity = 1024 };
+        
+            /**
+             * Constructor
+             */
+            share_queue();
+        
+            /**
+             * Pushes a share (from any thread).
+             * @param val The value.
+             * @return False if the queue is full.
+             */
+            bool push(const share_t & val);
+        
+            /**
+             * Pops a share (from a single thread).
+             * @param val The value.
+             * @return False if the queue is empty.
+             */
+            bool pop(share_t & val);
+        
+        private:
+        
+            /**
+             * The cell.
+             */
+            typedef struct cell_s
+            {
+                std::atomic<std::size_t> sequence;
+                share_t share;
+            } cell_t;
+        
+            /**
+             * The cells.
+             */
+            cell_t m_cells[capacity];
+        
+            /**
+             * The enqueue position.
+             */
+            std::atomic<std::size_t> m_enqueue_position;
+        
+            /**
+             * The dequeue position.
+             */
+            std::size_t m_dequeue_position;
+        
+        protected:
+        
+            // ...
+    };
+    
+} // namespace miner
+
+#endif // MINER_SHARE_QUEUE_HPP
@@ -21,6 +21,7 @@
 #ifndef MINER_STACK_HPP
 #define MINER_STACK_HPP
 
+#include <cstdint>
 #include <map>
 #include <string>
 
@@ -54,6 +55,25 @@ namespace miner {
              */
             void stop();
         
+            /**
+             * Sets the number of (CPU) device cores at runtime without
+             * restarting the stack.
+             * @param val The value.
+             */
+            void set_device_cores(const std::uint32_t & val);
+        
+            /**
+             * Adds to (or removes from) the number of (CPU) device cores at
+             * runtime, keeping at least one.
+             * @param delta The delta.
+             */
+            void adjust_device_cores(const std::int32_t & delta);
+        
+            /**
+             * The number of (CPU) device cores.
+             */
+            std::uint32_t device_cores();
+        
         private:
         
             // ...
@@ -22,6 +22,8 @@
 #define MINER_STACK_IMPL_HPP
 
 #include <cstdint>
+#include <map>
+#include <memory>
 #include <thread>
 #include <vector>
 
@@ -33,6 +35,7 @@ namespace miner {
     class gpu_manager;
     class serial_manager;
     class stack;
+    class stratum_server;
     class stratum_work;
     class work_manager;
     
@@ -78,11 +81,39 @@ namespace miner {
              */
             void handle_work(const std::shared_ptr<stratum_work> & work);
         
+            /**
+             * Handles the work of multiple work hosts (hashing is split
+             * across them).
+             * @param works The stratum_work by work host index.
+             */
+            void handle_works(
+                const std::map<std::uint32_t,
+                std::shared_ptr<stratum_work> > & works
+            );
+        
             /**
              * Updates the statistics.
              */
             void update_statistics();
         
+            /**
+             * Sets the number of (CPU) device cores at runtime.
+             * @param val The value.
+             */
+            void set_device_cores(const std::uint32_t & val);
+        
+            /**
+             * Adds to (or removes from) the number of (CPU) device cores at
+             * runtime, keeping at least one.
+             * @param delta The delta.
+             */
+            void adjust_device_cores(const std::int32_t & delta);
+        
+            /**
+             * The number of (CPU) device cores.
+             */
+            std::uint32_t device_cores();
+        
         private:
         
             /**
@@ -105,6 +136,11 @@ namespace miner {
              */
             std::shared_ptr<work_manager> m_work_manager;
         
+            /**
+             * The stratum_server (proxy).
+             */
+            std::shared_ptr<stratum_server> m_stratum_server;
+        
             /**
              * The boost::asio::io_service.
              */
@@ -122,8 +158,9 @@ namespace miner {
         
             /**
              * The main loop.
+             * @param index The io_service thread index.
              */
-            void loop();
+            void loop(const std::uint32_t & index);
 
             /**
              * The stack.
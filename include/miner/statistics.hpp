@@ -21,6 +21,13 @@
 #ifndef MINER_STATISTICS_HPP
 #define MINER_STATISTICS_HPP
 
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+
 namespace miner {
 
     /**
@@ -51,13 +58,138 @@ namespace miner {
              */
             const double & hashes_per_second() const;
         
+            /**
+             * Sets the power in watts.
+             * @param val The value.
+             */
+            void set_watts(const double & val);
+        
+            /**
+             * The power in watts (zero if unavailable).
+             */
+            const double & watts() const;
+        
+            /**
+             * Sets the temperature in degrees Celsius.
+             * @param val The value.
+             */
+            void set_temperature(const double & val);
+        
+            /**
+             * The temperature in degrees Celsius (zero if unavailable).
+             */
+            const double & temperature() const;
+        
+            /**
+             * The (combined) hashes per joule (zero if unavailable).
+             */
+            double hashes_per_joule() const;
+        
+            /**
+             * Sets the latency (in microseconds) from a work notify to the
+             * first hash on it.
+             * @param val The value.
+             */
+            void set_work_latency(const double & val);
+        
+            /**
+             * The latency (in microseconds) from the last work notify to the
+             * first hash on it.
+             */
+            double work_latency() const;
+        
+            /**
+             * The submit latency histogram bucket bounds in milliseconds (the
+             * last bucket is unbounded).
+             */
+            enum { submit_latency_buckets = 8 };
+        
+            /**
+             * The job age histogram bucket bounds in seconds (the last bucket
+             * is unbounded).
+             */
+            enum { submit_job_age_buckets = 6 };
+        
+            /**
+             * The submit statistics of a pool.
+             */
+            typedef struct submits_s
+            {
+                std::uint32_t latency[submit_latency_buckets];
+                std::uint32_t accepted[submit_job_age_buckets];
+                std::uint32_t rejected[submit_job_age_buckets];
+                double latency_total;
+                std::uint32_t count;
+                std::uint32_t rejected_stale;
+                std::uint32_t dropped_stale;
+            } submits_t;
+        
+            /**
+             * Records a mining.submit result.
+             * @param pool The pool (host:port).
+             * @param latency The time from the submit to the result.
+             * @param job_age The time from the job notify to the submit.
+             * @param accepted If true the share was accepted.
+             * @param stale If true the share was rejected as stale.
+             */
+            void record_submit(
+                const std::string & pool,
+                const std::chrono::steady_clock::duration & latency,
+                const std::chrono::steady_clock::duration & job_age,
+                const bool & accepted, const bool & stale = false
+            );
+        
+            /**
+             * Records a share dropped (not submitted) because it's job was
+             * invalidated by a clean jobs notify.
+             * @param pool The pool (host:port).
+             */
+            void record_stale_drop(const std::string & pool);
+        
+            /**
+             * The submit statistics of each pool formatted for the log.
+             */
+            std::string submits_report();
+        
         private:
         
+            /**
+             * The submit statistics of a pool (the submits std::mutex must
+             * be held).
+             * @param pool The pool (host:port).
+             */
+            submits_t & submits(const std::string & pool);
+        
             /**
              * The (combined) hashes per second.
              */
             double m_hashes_per_second;
         
+            /**
+             * The power in watts.
+             */
+            double m_watts;
+        
+            /**
+             * The temperature in degrees Celsius.
+             */
+            double m_temperature;
+        
+            /**
+             * The latency from a work notify to the first hash on it.
+             */
+            std::atomic<double> m_work_latency;
+        
+            /**
+             * The submit statistics of each pool.
+             */
+            std::map<std::string, submits_t> m_submits;
+        
+            /**
+             * The submits std::mutex.
+             */
+            std::mutex mutex_submits_;
+        
         protected:
       
             // ...
@@ -21,18 +21,26 @@
 #ifndef MINING_STRATUM_CONNECTION_HPP
 #define MINING_STRATUM_CONNECTION_HPP
 
+#include <chrono>
 #include <deque>
+#include <functional>
+#include <map>
 #include <string>
 #include <memory>
 #include <vector>
 
 #include <boost/asio.hpp>
-#include <boost/property_tree/ptree.hpp>
+#include <boost/asio/coroutine.hpp>
+
+#include <miner/handler_allocator.hpp>
+#include <miner/share_queue.hpp>
+#include <miner/stratum_parser.hpp>
 
 namespace miner {
 
     class stack_impl;
     class stratum_work;
+    class tcp_connector;
     
     /**
      * Implements a stratum connection.
@@ -42,11 +50,46 @@ namespace miner {
     {
         public:
         
+            /**
+             * The states (in order).
+             */
+            typedef enum state_s
+            {
+                state_none,
+                state_resolving,
+                state_connecting,
+                state_subscribing,
+                state_authorizing,
+                state_notifying,
+                state_mining,
+                state_stopped,
+            } state_t;
+        
+            /**
+             * An in-flight mining.submit.
+             */
+            typedef struct submit_s
+            {
+                std::uint32_t job_handle;
+                std::uint32_t nonce;
+                std::chrono::steady_clock::time_point time_notified;
+                std::chrono::steady_clock::time_point time_sent;
+                std::function<void (const bool &)> handler;
+            } submit_t;
+        
             /**
              * Constructor
              * @param owner The stack_impl.
+             * @param work_host_index The (configured) work host index.
              */
-            explicit stratum_connection(stack_impl & owner);
+            explicit stratum_connection(
+                stack_impl & owner, const std::uint32_t & work_host_index
+            );
+        
+            /**
+             * Destructor
+             */
+            virtual ~stratum_connection();
         
             /**
              * Starts
@@ -58,32 +101,109 @@ namespace miner {
              */
             void stop();
         
+            /**
+             * Sets the session to offer for resumption in the
+             * mining.subscribe (before starting).
+             * @param session_id The session (subscription) id.
+             * @param extranonce1 The extranonce1 of the session.
+             * @param extranonce2_size The extranonce2 size of the session.
+             */
+            void set_session(
+                const std::string & session_id,
+                const std::vector<std::uint8_t> & extranonce1,
+                const std::size_t & extranonce2_size
+            );
+        
             /**
              * Performs a write operation.
              * buf The buffer.
              */
             void write(const std::string & buf);
         
-        private:
+            /**
+             * Performs a write operation (of a pooled buffer, it is not
+             * copied).
+             * buf The buffer.
+             * @param priority If true the buffer is written before any
+             * other queued buffers (e.g. a mining.submit).
+             */
+            void write(
+                const std::shared_ptr<std::string> & buf,
+                const bool & priority = false
+            );
         
             /**
-             * Perfoms a connect operation.
-             * @param it_endpoint The iterator.
+             * Submits a share, the id is assigned and patched into the
+             * buffer (which must not be shared) and the result is matched
+             * to it.
+             * @param buf The (rendered mining.submit) buffer.
+             * @param id_offset The offset of the id slot.
+             * @param val The submit_t.
              */
-            void do_connect(
-                boost::asio::ip::tcp::resolver::iterator it_endpoint
+            void submit(
+                const std::shared_ptr<std::string> & buf,
+                const std::size_t & id_offset, const submit_t & val
             );
         
             /**
-             * Performs a read operation.
+             * Submits a share of a header-only (Stratum V2) job.
+             * @param share The share_queue::share_t.
+             * @param work The stratum_work.
+             * @param val The submit_t.
              */
-            void do_read();
+            virtual void submit_header(
+                const share_queue::share_t & share,
+                const std::shared_ptr<stratum_work> & work,
+                const submit_t & val
+            );
         
             /**
-             * Performs a write operation.
-             * buf The buffer.
+             * Measures the share rate and suggests a difficulty
+             * (mining.suggest_difficulty) that keeps it near the configured
+             * share rate.
+             */
+            virtual void suggest_difficulty();
+        
+            /**
+             * The state.
+             */
+            const state_t & state() const;
+        
+            /**
+             * The (configured) work host index.
              */
-            void do_write(const std::string & buf);
+            const std::uint32_t & work_host_index() const;
+        
+        protected:
+        
+            /**
+             * Runs the (stackless) coroutine, resolve, connect, subscribe and
+             * authorize then read each line until closed.
+             * @param ec The boost::system::error_code.
+             * @param len The length.
+             */
+            virtual void run(
+                const boost::system::error_code & ec, std::size_t len
+            );
+        
+            /**
+             * Sets the state and the deadline of it.
+             * @param val The value.
+             */
+            void set_state(const state_t & val);
+        
+            /**
+             * Closes the socket and stops the coroutine.
+             */
+            void close();
+        
+            /**
+             * Writes everything queued with a single (gather) write
+             * operation.
+             */
+            void do_write();
+        
+        private:
         
             /**
              * The next difficulty.
@@ -115,52 +235,60 @@ namespace miner {
              */
             std::vector<std::uint8_t> m_extranonce2;
         
+            /**
+             * The state.
+             */
+            state_t m_state;
+        
         protected:
         
             /**
-             * Handles a JSON line.
-             * @Param json_line The json_line.
+             * Handles a JSON line (in place).
+             * @param buf The buffer.
+             * @param len The length.
              */
-            void handle_json_line(const std::string & json_line);
+            void handle_json_line(const char * buf, const std::size_t & len);
         
             /**
              * Handles a JSON-RPC method.
              * @param id The id.
-             * @param method The method.
-             * @param params The params.
+             * @param method The method token.
+             * @param params The params token.
              */
             void handle_json_rpc_method(
-                const std::string & id, const std::string & method,
-                const boost::property_tree::ptree & params
+                const std::uint64_t & id, const int & method,
+                const int & params
             );
         
             /**
              * Handles a JSON-RPC result.
              * @param id The id.
-             * @param result The result.
+             * @param result The result token.
              */
             void handle_json_rpc_result(
-                const std::string & id,
-                const boost::property_tree::ptree & result
+                const std::uint64_t & id, const int & result
             );
         
             /**
              * Handles a JSON-RPC error.
              * @param id The id.
-             * @param error The error.
+             * @param error The error token.
              */
             void handle_json_rpc_error(
-                const std::string & id,
-                const boost::property_tree::ptree & error
+                const std::uint64_t & id, const int & error
             );
         
             /**
              * Handles a mining.notify method.
-             * @param params The boost::property_tree::ptree.
+             * @param params The params token.
              */
-            void handle_mining_notify(
-                const boost::property_tree::ptree & params
-            );
+            void handle_mining_notify(const int & params);
+        
+            /**
+             * Handles a mining.set_extranonce method.
+             * @param params The params token.
+             */
+            void handle_mining_set_extranonce(const int & params);
         
             /**
              * Attempts to generate a work from stratum.
@@ -174,18 +302,26 @@ namespace miner {
              * @param time The time.
              */
             std::shared_ptr<stratum_work> generate_work(
-                const std::string & job_id, const std::string & previous_hash,
-                const std::string & coinb1, const std::string & coinb2,
-                const std::vector<std::string> & merkles,
-                const std::string & version, const std::string & bits,
-                const std::string & time
+                const std::string & job_id,
+                const std::vector<std::uint8_t> & previous_hash,
+                const std::vector<std::uint8_t> & coinb1,
+                const std::vector<std::uint8_t> & coinb2,
+                const std::vector< std::vector<std::uint8_t> > & merkles,
+                const std::vector<std::uint8_t> & version,
+                const std::vector<std::uint8_t> & bits,
+                const std::vector<std::uint8_t> & time
             );
         
             /**
              * Handles a mining.submit result.
              * @param result The result.
+             * @param submit The submit_t.
+             * @param stale If true the share was rejected as stale.
              */
-            void handle_mining_submit_result(const bool & result);
+            void handle_mining_submit_result(
+                const bool & result, const submit_t & submit,
+                const bool & stale = false
+            );
         
             /**
              * The stack_impl.
@@ -198,12 +334,42 @@ namespace miner {
             boost::asio::strand strand_;
         
             /**
-             * The timeout timer.
+             * The timeout timer (the deadline of the current state).
              */
             boost::asio::basic_waitable_timer<
                 std::chrono::steady_clock
             > timeout_timer_;
         
+            /**
+             * The boost::asio::coroutine.
+             */
+            boost::asio::coroutine coroutine_;
+        
+            /**
+             * The resolver.
+             */
+            boost::asio::ip::tcp::resolver resolver_;
+        
+            /**
+             * The resolved (or cached) endpoints.
+             */
+            std::vector<boost::asio::ip::tcp::endpoint> endpoints_;
+        
+            /**
+             * The tcp_connector.
+             */
+            std::shared_ptr<tcp_connector> connector_;
+        
+            /**
+             * The read handler_allocator.
+             */
+            handler_allocator handler_allocator_read_;
+        
+            /**
+             * The write handler_allocator.
+             */
+            handler_allocator handler_allocator_write_;
+        
             /**
              * The socket.
              */
@@ -214,15 +380,114 @@ namespace miner {
              */
             std::unique_ptr<boost::asio::streambuf> response_;
         
+            /**
+             * The stratum_parser.
+             */
+            stratum_parser parser_;
+        
             /**
              * The write queue.
              */
-            std::deque<std::string> write_queue_;
+            std::deque< std::shared_ptr<std::string> > write_queue_;
+        
+            /**
+             * The priority write queue (written first).
+             */
+            std::deque< std::shared_ptr<std::string> > write_queue_priority_;
+        
+            /**
+             * The buffers being written.
+             */
+            std::vector< std::shared_ptr<std::string> > writing_;
+        
+            /**
+             * The buffer sequence being written.
+             */
+            std::vector<boost::asio::const_buffer> write_buffers_;
         
             /**
              * The last job id.
              */
             std::string last_job_id_;
+        
+            /**
+             * The (configured) work host index.
+             */
+            std::uint32_t work_host_index_;
+        
+            /**
+             * The host.
+             */
+            std::string host_;
+        
+            /**
+             * The port.
+             */
+            std::uint16_t port_;
+        
+            /**
+             * The username.
+             */
+            std::string username_;
+        
+            /**
+             * The password.
+             */
+            std::string password_;
+        
+            /**
+             * The time the connect started.
+             */
+            std::chrono::steady_clock::time_point time_connect_;
+        
+            /**
+             * The time the mining.subscribe was written.
+             */
+            std::chrono::steady_clock::time_point time_subscribe_;
+        
+            /**
+             * The pool (host:port).
+             */
+            std::string pool_;
+        
+            /**
+             * The next request id (1, 2 and 3 are the mining.subscribe,
+             * mining.authorize and mining.extranonce.subscribe).
+             */
+            std::uint64_t next_id_;
+        
+            /**
+             * The in-flight mining.submit's by id.
+             */
+            std::map<std::uint64_t, submit_t> submits_;
+        
+            /**
+             * The mining.submit's (by id) held until the (resumed)
+             * session is authorized.
+             */
+            std::vector<
+                std::pair<std::uint64_t, std::shared_ptr<std::string> >
+            > submits_pending_;
+        
+            /**
+             * The latest work (the difficulty is applied to it in place).
+             */
+            std::shared_ptr<stratum_work> work_;
+        
+            /**
+             * The shares submitted since the share rate was last measured.
+             */
+            std::uint32_t shares_;
+        
+            /**
+             * The time the share rate was last measured.
+             */
+            std::chrono::steady_clock::time_point time_shares_;
+        
+            /**
+             * The id of the last mining.suggest_difficulty.
+             */
+            std::uint64_t suggest_difficulty_id_;
     };
     
 } // namespace miner
@@ -0,0 +1,211 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINER_STRATUM_PARSER_HPP
+#define MINER_STRATUM_PARSER_HPP
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace miner {
+
+    /**
+     * Implements a JSON tokenizer for stratum lines. The line is tokenized
+     * in place (tokens are offsets into the caller's buffer) and the token
+     * storage is reused between lines so that parsing does not allocate.
+     * @note Only the structure is validated, strings are not unescaped.
+     */
+    class stratum_parser
+    {
+        public:
+        
+            /**
+             * The token types.
+             */
+            typedef enum token_type_s
+            {
+                token_type_none,
+                token_type_object,
+                token_type_array,
+                token_type_string,
+                token_type_primitive,
+            } token_type_t;
+        
+            /**
+             * The token.
+             */
+            typedef struct token_s
+            {
+                token_type_t type;
+                std::uint32_t begin;
+                std::uint32_t end;
+                std::uint32_t size;
+                std::uint32_t next;
+            } token_t;
+        
+            /**
+             * Constructor
+             */
+            stratum_parser();
+        
+            /**
+             * Tokenizes a line.
+             * @param buf The buffer (must outlive the tokens).
+             * @param len The length.
+             * @return False if the line is not well formed.
+             */
+            bool parse(const char * buf, const std::size_t & len);
+        
+            /**
+             * The number of tokens (the root is token 0).
+             */
+            std::size_t size() const;
+        
+            /**
+             * Finds the value of a key of an object.
+             * @param index The object token.
+             * @param key The key.
+             * @return The value token or -1.
+             */
+            int find(const int & index, const char * key) const;
+        
+            /**
+             * The nth element of an array.
+             * @param index The array token.
+             * @param n The n.
+             * @return The element token or -1.
+             */
+            int at(const int & index, const std::size_t & n) const;
+        
+            /**
+             * The number of elements of an array or object.
+             * @param index The token.
+             */
+            std::size_t count(const int & index) const;
+        
+            /**
+             * The index of the token following the given one (and all of it's
+             * children).
+             * @param index The token.
+             */
+            int next(const int & index) const;
+        
+            /**
+             * If true the token is an array.
+             * @param index The token.
+             */
+            bool is_array(const int & index) const;
+        
+            /**
+             * If true the token is null (or absent).
+             * @param index The token.
+             */
+            bool is_null(const int & index) const;
+        
+            /**
+             * If true the token is equal to the string.
+             * @param index The token.
+             * @param val The value.
+             */
+            bool equals(const int & index, const char * val) const;
+        
+            /**
+             * The pointer to the characters of the token.
+             * @param index The token.
+             */
+            const char * data(const int & index) const;
+        
+            /**
+             * The length of the characters of the token.
+             * @param index The token.
+             */
+            std::size_t length(const int & index) const;
+        
+            /**
+             * Copies the token to a std::string.
+             * @param index The token.
+             */
+            std::string to_string(const int & index) const;
+        
+            /**
+             * The token as a double.
+             * @param index The token.
+             */
+            double to_double(const int & index) const;
+        
+            /**
+             * The token as an unsigned integer.
+             * @param index The token.
+             */
+            std::uint64_t to_uint64(const int & index) const;
+        
+            /**
+             * The token as a bool.
+             * @param index The token.
+             */
+            bool to_bool(const int & index) const;
+        
+            /**
+             * Decodes a hexidecimal string token.
+             * @param index The token.
+             * @param val The value.
+             */
+            bool to_bytes(
+                const int & index, std::vector<std::uint8_t> & val
+            ) const;
+        
+        private:
+        
+            /**
+             * Appends a token.
+             * @param type The token_type_t.
+             * @param begin The begin.
+             * @param end The end.
+             */
+            void push(
+                const token_type_t & type, const std::uint32_t & begin,
+                const std::uint32_t & end
+            );
+        
+            /**
+             * The buffer.
+             */
+            const char * buf_;
+        
+            /**
+             * The tokens.
+             */
+            std::vector<token_t> tokens_;
+        
+            /**
+             * The open array and object tokens.
+             */
+            std::vector<std::uint32_t> stack_;
+        
+        protected:
+        
+            // ...
+    };
+
+} // namespace miner
+
+#endif // MINER_STRATUM_PARSER_HPP
@@ -0,0 +1,188 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINER_STRATUM_PROBE_HPP
+#define MINER_STRATUM_PROBE_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/coroutine.hpp>
+
+#include <miner/stratum_parser.hpp>
+
+namespace miner {
+
+    class stack_impl;
+    class tcp_connector;
+
+    /**
+     * Implements a (non-blocking) health probe of a work host, it connects
+     * and performs a mining.subscribe round trip within a deadline then
+     * reports the result to the work_manager.
+     */
+    class stratum_probe
+        : public std::enable_shared_from_this<stratum_probe>
+    {
+        public:
+        
+            /**
+             * The result.
+             */
+            typedef struct result_s
+            {
+                bool success;
+                std::chrono::microseconds rtt_connect;
+                std::chrono::microseconds rtt_subscribe;
+                std::chrono::steady_clock::time_point time;
+            } result_t;
+        
+            /**
+             * Constructor
+             * @param owner The stack_impl.
+             * @param work_host_index The (configured) work host index.
+             */
+            explicit stratum_probe(
+                stack_impl & owner, const std::uint32_t & work_host_index
+            );
+        
+            /**
+             * Starts
+             */
+            void start();
+        
+            /**
+             * Stops
+             */
+            void stop();
+        
+        private:
+        
+            /**
+             * Runs the (stackless) coroutine, resolve, connect, subscribe
+             * and read until the mining.subscribe result.
+             * @param ec The boost::system::error_code.
+             * @param len The length.
+             */
+            void run(const boost::system::error_code & ec, std::size_t len);
+        
+            /**
+             * Closes the socket and reports the result (once).
+             * @param success If true the probe succeeded.
+             */
+            void finish(const bool & success);
+        
+        protected:
+        
+            /**
+             * The stack_impl.
+             */
+            stack_impl & stack_impl_;
+        
+            /**
+             * The boost::asio::strand.
+             */
+            boost::asio::strand strand_;
+        
+            /**
+             * The deadline timer.
+             */
+            boost::asio::basic_waitable_timer<
+                std::chrono::steady_clock
+            > timeout_timer_;
+        
+            /**
+             * The boost::asio::coroutine.
+             */
+            boost::asio::coroutine coroutine_;
+        
+            /**
+             * The resolver.
+             */
+            boost::asio::ip::tcp::resolver resolver_;
+        
+            /**
+             * The resolved (or cached) endpoints.
+             */
+            std::vector<boost::asio::ip::tcp::endpoint> endpoints_;
+        
+            /**
+             * The tcp_connector.
+             */
+            std::shared_ptr<tcp_connector> connector_;
+        
+            /**
+             * The socket.
+             */
+            std::shared_ptr<boost::asio::ip::tcp::socket> socket_;
+        
+            /**
+             * The response.
+             */
+            boost::asio::streambuf response_;
+        
+            /**
+             * The stratum_parser.
+             */
+            stratum_parser parser_;
+        
+            /**
+             * The (configured) work host index.
+             */
+            std::uint32_t work_host_index_;
+        
+            /**
+             * The host.
+             */
+            std::string host_;
+        
+            /**
+             * The port.
+             */
+            std::uint16_t port_;
+        
+            /**
+             * The time the connect started.
+             */
+            std::chrono::steady_clock::time_point time_connect_;
+        
+            /**
+             * The time the mining.subscribe was written.
+             */
+            std::chrono::steady_clock::time_point time_subscribe_;
+        
+            /**
+             * The result.
+             */
+            result_t result_;
+        
+            /**
+             * If true the result was reported.
+             */
+            bool finished_;
+    };
+
+} // namespace miner
+
+#endif // MINER_STRATUM_PROBE_HPP
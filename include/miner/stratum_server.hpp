@@ -0,0 +1,177 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINER_STRATUM_SERVER_HPP
+#define MINER_STRATUM_SERVER_HPP
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace miner {
+
+    class stack_impl;
+    class stratum_server_connection;
+    class stratum_work;
+
+    /**
+     * Implements a stratum (proxy) server, downstream miners share the
+     * upstream connection of the work manager. Each is given it's own
+     * extranonce1 (the upstream extranonce1 followed by a suffix taken from
+     * the upstream extranonce2), the jobs are re-issued to them and their
+     * shares are forwarded upstream.
+     */
+    class stratum_server
+        : public std::enable_shared_from_this<stratum_server>
+    {
+        public:
+        
+            /**
+             * The (maximum) size of the extranonce1 suffix in bytes.
+             */
+            enum { extranonce1_suffix_size = 2 };
+        
+            /**
+             * Constructor
+             * @param owner The stack_impl.
+             */
+            explicit stratum_server(stack_impl & owner);
+        
+            /**
+             * Starts
+             * @param address The address.
+             * @param port The port.
+             */
+            void start(
+                const std::string & address, const std::uint16_t & port
+            );
+        
+            /**
+             * Stops
+             */
+            void stop();
+        
+            /**
+             * Sets the (upstream) work, it is re-issued to the downstream
+             * miners.
+             * @param val The value.
+             */
+            void set_work(const std::shared_ptr<stratum_work> & val);
+        
+            /**
+             * Allocates the extranonce1 (and extranonce2 size) of a
+             * downstream miner.
+             * @param extranonce1 The extranonce1.
+             * @param suffix The extranonce1 suffix (to be released).
+             * @param suffix_size The size of the extranonce1 suffix.
+             * @param extranonce2_size The extranonce2 size.
+             * @return False if there is no (upstream) work yet or all of
+             * the extranonce1 suffixes are in use.
+             */
+            bool allocate_extranonce(
+                std::vector<std::uint8_t> & extranonce1,
+                std::uint32_t & suffix, std::size_t & suffix_size,
+                std::size_t & extranonce2_size
+            );
+        
+            /**
+             * Releases the extranonce1 suffix of a downstream miner.
+             * @param suffix The extranonce1 suffix.
+             */
+            void release_extranonce(const std::uint32_t & suffix);
+        
+            /**
+             * The current (upstream) work.
+             */
+            std::shared_ptr<stratum_work> work();
+        
+            /**
+             * Renders a mining.notify of a work, the job id is the job
+             * handle of the work manager.
+             * @param work The stratum_work.
+             * @param clean_jobs If true the downstream miners abandon the
+             * previous jobs.
+             */
+            static std::shared_ptr<std::string> render_mining_notify(
+                const std::shared_ptr<stratum_work> & work,
+                const bool & clean_jobs
+            );
+        
+        private:
+        
+            /**
+             * Accepts the next downstream connection.
+             */
+            void do_accept();
+        
+        protected:
+        
+            /**
+             * The stack_impl.
+             */
+            stack_impl & stack_impl_;
+        
+            /**
+             * The boost::asio::strand.
+             */
+            boost::asio::strand strand_;
+        
+            /**
+             * The acceptor.
+             */
+            boost::asio::ip::tcp::acceptor acceptor_;
+        
+            /**
+             * The downstream connections.
+             */
+            std::vector<
+                std::weak_ptr<stratum_server_connection>
+            > stratum_server_connections_;
+        
+            /**
+             * The current (upstream) work.
+             */
+            std::shared_ptr<stratum_work> work_;
+        
+            /**
+             * The std::mutex.
+             */
+            std::mutex mutex_;
+        
+            /**
+             * The next extranonce1 suffix (zero is left to the local
+             * devices).
+             */
+            std::uint32_t next_extranonce1_suffix_;
+        
+            /**
+             * The extranonce1 suffixes in use by the downstream miners.
+             */
+            std::set<std::uint32_t> extranonce1_suffixes_;
+    };
+
+} // namespace miner
+
+#endif // MINER_STRATUM_SERVER_HPP
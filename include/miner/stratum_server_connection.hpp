@@ -0,0 +1,254 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINER_STRATUM_SERVER_CONNECTION_HPP
+#define MINER_STRATUM_SERVER_CONNECTION_HPP
+
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <boost/asio.hpp>
+#include <boost/asio/coroutine.hpp>
+
+#include <miner/stratum_parser.hpp>
+
+namespace miner {
+
+    class stack_impl;
+    class stratum_server;
+    class stratum_work;
+
+    /**
+     * Implements a (downstream) stratum server connection.
+     */
+    class stratum_server_connection
+        : public std::enable_shared_from_this<stratum_server_connection>
+    {
+        public:
+        
+            /**
+             * Constructor
+             * @param owner The stack_impl.
+             * @param server The stratum_server.
+             * @param socket The (accepted) socket.
+             */
+            explicit stratum_server_connection(
+                stack_impl & owner, stratum_server & server,
+                const std::shared_ptr<boost::asio::ip::tcp::socket> & socket
+            );
+        
+            /**
+             * Starts
+             */
+            void start();
+        
+            /**
+             * Stops
+             */
+            void stop();
+        
+            /**
+             * Sets the (upstream) work.
+             * @param work The stratum_work.
+             * @param mining_notify The (rendered) mining.notify.
+             */
+            void set_work(
+                const std::shared_ptr<stratum_work> & work,
+                const std::shared_ptr<std::string> & mining_notify
+            );
+        
+        private:
+        
+            /**
+             * Runs the (stackless) coroutine, reads each line until closed.
+             * @param ec The boost::system::error_code.
+             * @param len The length.
+             */
+            void run(const boost::system::error_code & ec, std::size_t len);
+        
+            /**
+             * Closes the socket and stops the coroutine.
+             */
+            void close();
+        
+            /**
+             * Writes (queues) a buffer.
+             * @param buf The buffer.
+             */
+            void write(const std::shared_ptr<std::string> & buf);
+        
+            /**
+             * Writes everything queued with a single (gather) write
+             * operation.
+             */
+            void do_write();
+        
+            /**
+             * Writes a JSON-RPC result (or error).
+             * @param id The id.
+             * @param result The result (JSON).
+             * @param error The error (JSON).
+             */
+            void write_result(
+                const std::uint64_t & id, const std::string & result,
+                const std::string & error = "null"
+            );
+        
+            /**
+             * Writes the mining.set_difficulty and mining.notify of a work.
+             * @param work The stratum_work.
+             * @param mining_notify The (rendered) mining.notify.
+             */
+            void notify(
+                const std::shared_ptr<stratum_work> & work,
+                const std::shared_ptr<std::string> & mining_notify
+            );
+        
+        protected:
+        
+            /**
+             * Handles a JSON line (in place).
+             * @param buf The buffer.
+             * @param len The length.
+             */
+            void handle_json_line(const char * buf, const std::size_t & len);
+        
+            /**
+             * Handles a mining.subscribe method.
+             * @param id The id.
+             */
+            void handle_mining_subscribe(const std::uint64_t & id);
+        
+            /**
+             * Handles a mining.authorize method.
+             * @param id The id.
+             * @param params The params token.
+             */
+            void handle_mining_authorize(
+                const std::uint64_t & id, const int & params
+            );
+        
+            /**
+             * Handles a mining.submit method.
+             * @param id The id.
+             * @param params The params token.
+             */
+            void handle_mining_submit(
+                const std::uint64_t & id, const int & params
+            );
+        
+            /**
+             * The stack_impl.
+             */
+            stack_impl & stack_impl_;
+        
+            /**
+             * The stratum_server.
+             */
+            stratum_server & stratum_server_;
+        
+            /**
+             * The boost::asio::strand.
+             */
+            boost::asio::strand strand_;
+        
+            /**
+             * The boost::asio::coroutine.
+             */
+            boost::asio::coroutine coroutine_;
+        
+            /**
+             * The socket.
+             */
+            std::shared_ptr<boost::asio::ip::tcp::socket> socket_;
+        
+            /**
+             * The remote endpoint (for logging).
+             */
+            std::string remote_endpoint_;
+        
+            /**
+             * The request.
+             */
+            boost::asio::streambuf request_;
+        
+            /**
+             * The stratum_parser.
+             */
+            stratum_parser parser_;
+        
+            /**
+             * The write queue.
+             */
+            std::deque< std::shared_ptr<std::string> > write_queue_;
+        
+            /**
+             * The buffers being written.
+             */
+            std::vector< std::shared_ptr<std::string> > writing_;
+        
+            /**
+             * The buffer sequence being written.
+             */
+            std::vector<boost::asio::const_buffer> write_buffers_;
+        
+            /**
+             * The extranonce1 (the upstream extranonce1 followed by the
+             * suffix).
+             */
+            std::vector<std::uint8_t> extranonce1_;
+        
+            /**
+             * The size of the upstream extranonce1.
+             */
+            std::size_t upstream_extranonce1_size_;
+        
+            /**
+             * The extranonce1 suffix (zero if none is allocated).
+             */
+            std::uint32_t extranonce1_suffix_;
+        
+            /**
+             * The extranonce2 size.
+             */
+            std::size_t extranonce2_size_;
+        
+            /**
+             * If true the mining.authorize was accepted.
+             */
+            bool authorized_;
+        
+            /**
+             * The difficulty last sent.
+             */
+            double difficulty_;
+        
+            /**
+             * If true the connection is closed.
+             */
+            bool closed_;
+    };
+
+} // namespace miner
+
+#endif // MINER_STRATUM_SERVER_CONNECTION_HPP
@@ -0,0 +1,216 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINER_STRATUM_V2_CONNECTION_HPP
+#define MINER_STRATUM_V2_CONNECTION_HPP
+
+#include <cstdint>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <miner/stratum_connection.hpp>
+
+namespace miner {
+
+    /**
+     * Implements a Stratum V2 connection (a standard channel of the mining
+     * protocol). The jobs are header-only, the pool sends the merkle root
+     * so the coinbase and merkle branch are not rebuilt for each job.
+     * @note The messages are framed in the clear (the Noise handshake is
+     * not implemented) so it is meant for local (or trusted) pools and
+     * proxies.
+     */
+    class stratum_v2_connection : public stratum_connection
+    {
+        public:
+        
+            /**
+             * The message types.
+             */
+            typedef enum message_type_s
+            {
+                message_type_setup_connection = 0x00,
+                message_type_setup_connection_success = 0x01,
+                message_type_setup_connection_error = 0x02,
+                message_type_open_standard_mining_channel = 0x10,
+                message_type_open_standard_mining_channel_success = 0x11,
+                message_type_open_mining_channel_error = 0x12,
+                message_type_new_mining_job = 0x15,
+                message_type_submit_shares_standard = 0x1a,
+                message_type_submit_shares_success = 0x1c,
+                message_type_submit_shares_error = 0x1d,
+                message_type_set_new_prev_hash = 0x20,
+                message_type_set_target = 0x21,
+            } message_type_t;
+        
+            /**
+             * The channel message bit of the extension type.
+             */
+            enum { channel_msg = 0x8000 };
+        
+            /**
+             * The size of the frame header.
+             */
+            enum { header_length = 6 };
+        
+            /**
+             * The maximum length of a message payload we accept.
+             */
+            enum { max_payload_length = 65536 };
+        
+            /**
+             * Constructor
+             * @param owner The stack_impl.
+             * @param work_host_index The (configured) work host index.
+             */
+            explicit stratum_v2_connection(
+                stack_impl & owner, const std::uint32_t & work_host_index
+            );
+        
+            /**
+             * Submits a share of a header-only job (SubmitSharesStandard).
+             * @param share The share_queue::share_t.
+             * @param work The stratum_work.
+             * @param val The submit_t.
+             */
+            virtual void submit_header(
+                const share_queue::share_t & share,
+                const std::shared_ptr<stratum_work> & work,
+                const submit_t & val
+            );
+        
+            /**
+             * The pool sets the target of the channel (SetTarget) so no
+             * difficulty is suggested.
+             */
+            virtual void suggest_difficulty();
+        
+        private:
+        
+            /**
+             * A (header-only) job.
+             */
+            typedef struct job_s
+            {
+                std::uint32_t version;
+                std::vector<std::uint8_t> merkle_root;
+            } job_t;
+        
+            /**
+             * Runs the (stackless) coroutine, resolve, connect, set up the
+             * connection and open a channel then read each frame until
+             * closed.
+             * @param ec The boost::system::error_code.
+             * @param len The length.
+             */
+            virtual void run(
+                const boost::system::error_code & ec, std::size_t len
+            );
+        
+            /**
+             * Writes a message.
+             * @param type The message_type_t.
+             * @param payload The payload.
+             */
+            void write_message(
+                const message_type_t & type, const std::string & payload
+            );
+        
+            /**
+             * Handles a message.
+             * @param extension_type The extension type.
+             * @param type The message type.
+             * @param buf The payload.
+             * @param len The payload length.
+             * @return False if the message is malformed.
+             */
+            bool handle_message(
+                const std::uint16_t & extension_type,
+                const std::uint8_t & type, const std::uint8_t * buf,
+                const std::size_t & len
+            );
+        
+            /**
+             * Generates the work of a job with the current previous hash.
+             * @param job_id The job id.
+             * @param job The job_t.
+             */
+            void generate_work(
+                const std::uint32_t & job_id, const job_t & job
+            );
+        
+        protected:
+        
+            /**
+             * The frame header being read.
+             */
+            std::uint8_t header_[header_length];
+        
+            /**
+             * The payload being read.
+             */
+            std::vector<std::uint8_t> payload_;
+        
+            /**
+             * The channel id.
+             */
+            std::uint32_t channel_id_;
+        
+            /**
+             * The extranonce prefix (of the channel).
+             */
+            std::vector<std::uint8_t> extranonce_prefix_;
+        
+            /**
+             * The target (of the channel).
+             */
+            std::uint32_t target_[8];
+        
+            /**
+             * The (future) jobs by job id.
+             */
+            std::map<std::uint32_t, job_t> jobs_;
+        
+            /**
+             * The previous hash (as sent).
+             */
+            std::vector<std::uint8_t> previous_hash_;
+        
+            /**
+             * The minimum ntime.
+             */
+            std::uint32_t ntime_;
+        
+            /**
+             * The nbits.
+             */
+            std::uint32_t nbits_;
+        
+            /**
+             * The next sequence number of a SubmitSharesStandard.
+             */
+            std::uint32_t next_sequence_number_;
+    };
+
+} // namespace miner
+
+#endif // MINER_STRATUM_V2_CONNECTION_HPP
@@ -21,7 +21,10 @@
 #ifndef MINER_STRATUM_WORK_HPP
 #define MINER_STRATUM_WORK_HPP
 
+#include <chrono>
 #include <cstdint>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <vector>
 
@@ -57,7 +60,7 @@ namespace miner {
                 const std::vector<std::uint8_t> & previous_hash_bytes,
                 const std::vector<std::uint8_t> & coinb1_bytes,
                 const std::vector<std::uint8_t> & coinb2_bytes,
-                const std::vector<std::string> & merkles,
+                const std::vector< std::vector<std::uint8_t> > & merkles,
                 const std::vector<std::uint8_t> & version_bytes,
                 const std::vector<std::uint8_t> & bits_bytes,
                 const std::vector<std::uint8_t> & time_bytes,
@@ -84,20 +87,163 @@ namespace miner {
              */
             const std::vector<std::uint8_t> & extranonce2() const;
         
+            /**
+             * The previous hash.
+             */
+            const std::vector<std::uint8_t> & previous_hash() const;
+        
             /**
              * The time.
              */
             const std::vector<std::uint8_t> & time() const;
         
+            /**
+             * The extranonce1.
+             */
+            const std::vector<std::uint8_t> & extranonce1() const;
+        
+            /**
+             * The coinb1.
+             */
+            const std::vector<std::uint8_t> & coinb1() const;
+        
+            /**
+             * The coinb2.
+             */
+            const std::vector<std::uint8_t> & coinb2() const;
+        
+            /**
+             * The merkles.
+             */
+            const std::vector< std::vector<std::uint8_t> > & merkles() const;
+        
+            /**
+             * The version.
+             */
+            const std::vector<std::uint8_t> & version() const;
+        
+            /**
+             * The bits.
+             */
+            const std::vector<std::uint8_t> & bits() const;
+        
+            /**
+             * Sets the merkle root (of a header-only job), the coinbase and
+             * merkle branch are then not used.
+             * @param val The value.
+             */
+            void set_merkle_root(const std::vector<std::uint8_t> & val);
+        
+            /**
+             * The merkle root (empty unless the job is header-only).
+             */
+            const std::vector<std::uint8_t> & merkle_root() const;
+        
+            /**
+             * Sets the target and the (share) difficulty it was derived from
+             * atomically, the copies of the work (being hashed) share it.
+             * @param val The value (8 words).
+             * @param difficulty The difficulty.
+             */
+            void set_target(
+                const std::uint32_t * val, const double & difficulty
+            );
+        
+            /**
+             * Copies the target (it may change while the work is hashed).
+             * @param val The value (8 words).
+             */
+            void target(std::uint32_t * val) const;
+        
+            /**
+             * The (share) difficulty the target was derived from.
+             */
+            double difficulty() const;
+        
             /**
              * The data.
              */
             std::vector<std::uint32_t> & data();
         
             /**
-             * The target.
+             * Sets the time the work was notified (received from the pool).
+             * @param val The value.
              */
-            const std::uint32_t * target() const;
+            void set_time_notified(
+                const std::chrono::steady_clock::time_point & val
+            );
+        
+            /**
+             * The time the work was notified (received from the pool).
+             */
+            const std::chrono::steady_clock::time_point & time_notified() const;
+        
+            /**
+             * Sets the job handle (assigned by the work_manager).
+             * @param val The value.
+             */
+            void set_job_handle(const std::uint32_t & val);
+        
+            /**
+             * The job handle (assigned by the work_manager).
+             */
+            const std::uint32_t & job_handle() const;
+        
+            /**
+             * Sets the index of the work host that issued the work.
+             * @param val The value.
+             */
+            void set_work_host_index(const std::uint32_t & val);
+        
+            /**
+             * The index of the work host that issued the work.
+             */
+            const std::uint32_t & work_host_index() const;
+        
+            /**
+             * Sets the (clean jobs) generation of the work host the work was
+             * issued in (assigned by the work_manager).
+             * @param val The value.
+             */
+            void set_generation(const std::uint32_t & val);
+        
+            /**
+             * The (clean jobs) generation of the work host the work was
+             * issued in.
+             */
+            const std::uint32_t & generation() const;
+        
+            /**
+             * The mining.submit template.
+             */
+            typedef struct submit_template_s
+            {
+                std::string json;
+                std::size_t extranonce2_offset;
+                std::size_t extranonce2_length;
+                std::size_t time_offset;
+                std::size_t nonce_offset;
+                std::size_t id_offset;
+            } submit_template_t;
+        
+            /**
+             * The width of the id slot of the mining.submit template (the id
+             * is padded with whitespace).
+             */
+            enum { submit_id_length = 10 };
+        
+            /**
+             * Renders the mining.submit template (once per job) with
+             * fixed-width slots for the extranonce2, time, nonce and id.
+             */
+            void render_submit_template();
+        
+            /**
+             * The mining.submit template (shared by copies of the work).
+             */
+            const std::shared_ptr<const submit_template_t> &
+                submit_template() const
+            ;
         
         private:
         
@@ -129,7 +275,7 @@ namespace miner {
             /**
              * The merkles.
              */
-            std::vector<std::string> m_merkles;
+            std::vector< std::vector<std::uint8_t> > m_merkles;
         
             /**
              * The version.
@@ -140,6 +286,11 @@ namespace miner {
              * The bits.
              */
             std::vector<std::uint8_t> m_bits_bytes;
+        
+            /**
+             * The merkle root.
+             */
+            std::vector<std::uint8_t> m_merkle_root;
     
             /**
              * The extranonce1.
@@ -162,9 +313,44 @@ namespace miner {
             std::vector<std::uint32_t> m_data;
         
             /**
-             * The target.
+             * The target and the difficulty it was derived from.
+             */
+            typedef struct target_s
+            {
+                std::mutex mutex;
+                std::uint32_t words[8];
+                double difficulty;
+            } target_t;
+        
+            /**
+             * The target (shared by copies of the work).
+             */
+            std::shared_ptr<target_t> m_target;
+        
+            /**
+             * The time the work was notified.
+             */
+            std::chrono::steady_clock::time_point m_time_notified;
+        
+            /**
+             * The job handle.
+             */
+            std::uint32_t m_job_handle;
+        
+            /**
+             * The work host index.
+             */
+            std::uint32_t m_work_host_index;
+        
+            /**
+             * The generation.
+             */
+            std::uint32_t m_generation;
+        
+            /**
+             * The mining.submit template.
              */
-            std::vector<std::uint32_t> m_target;
+            std::shared_ptr<const submit_template_t> m_submit_template;
     
         protected:
         
@@ -0,0 +1,156 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef MINER_TCP_CONNECTOR_HPP
+#define MINER_TCP_CONNECTOR_HPP
+
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <vector>
+
+#include <boost/asio.hpp>
+
+namespace miner {
+
+    /**
+     * Implements a TCP connector that races the endpoints of a host (in the
+     * manner of Happy Eyeballs), an attempt is started on the next endpoint
+     * (alternating address families) each time the previous one fails or
+     * has not completed within the connection attempt delay, the first
+     * socket to connect is kept and the others are closed.
+     */
+    class tcp_connector
+        : public std::enable_shared_from_this<tcp_connector>
+    {
+        public:
+        
+            /**
+             * The connection attempt delay in milliseconds.
+             */
+            enum { connection_attempt_delay = 250 };
+        
+            /**
+             * The completion handler.
+             */
+            typedef std::function<
+                void (const boost::system::error_code &,
+                const std::shared_ptr<boost::asio::ip::tcp::socket> &)
+            > handler_t;
+        
+            /**
+             * Constructor
+             * @param ios The boost::asio::io_service.
+             * @param s The boost::asio::strand (of the owner, the handler is
+             * called on it).
+             */
+            explicit tcp_connector(
+                boost::asio::io_service & ios, boost::asio::strand & s
+            );
+        
+            /**
+             * Starts
+             * @param endpoints The endpoints.
+             * @param f The handler_t.
+             */
+            void start(
+                const std::vector<boost::asio::ip::tcp::endpoint> & endpoints,
+                const handler_t & f
+            );
+        
+            /**
+             * Cancels all attempts (the handler is not called).
+             * @note Must be called on the strand.
+             */
+            void cancel();
+        
+        private:
+        
+            /**
+             * Starts an attempt on the next endpoint.
+             */
+            void connect_next();
+        
+            /**
+             * Calls the handler (once).
+             * @param ec The boost::system::error_code.
+             * @param socket The socket.
+             */
+            void finish(
+                const boost::system::error_code & ec,
+                const std::shared_ptr<boost::asio::ip::tcp::socket> & socket
+            );
+        
+        protected:
+        
+            /**
+             * The boost::asio::io_service.
+             */
+            boost::asio::io_service & io_service_;
+        
+            /**
+             * The boost::asio::strand.
+             */
+            boost::asio::strand & strand_;
+        
+            /**
+             * The connection attempt delay timer.
+             */
+            boost::asio::basic_waitable_timer<
+                std::chrono::steady_clock
+            > timer_;
+        
+            /**
+             * The endpoints (in the order they are attempted).
+             */
+            std::vector<boost::asio::ip::tcp::endpoint> endpoints_;
+        
+            /**
+             * The index of the next endpoint.
+             */
+            std::size_t next_;
+        
+            /**
+             * The number of attempts in progress.
+             */
+            std::size_t pending_;
+        
+            /**
+             * The sockets of the attempts.
+             */
+            std::vector<
+                std::shared_ptr<boost::asio::ip::tcp::socket>
+            > sockets_;
+        
+            /**
+             * The handler_t.
+             */
+            handler_t handler_;
+        
+            /**
+             * If true the handler was called (or we were cancelled).
+             */
+            bool finished_;
+    };
+
+} // namespace miner
+
+#endif // MINER_TCP_CONNECTOR_HPP
@@ -40,6 +40,17 @@ namespace miner {
              */
             static std::vector<std::uint8_t> from_hex(const std::string & val);
         
+            /**
+             * Converts from hexidecimal format in place (without allocating).
+             * @param val The value.
+             * @param len The length (must be even).
+             * @param out The output (of len / 2 bytes).
+             * @return False if the value is not hexidecimal.
+             */
+            static bool from_hex(
+                const char * val, const std::size_t & len, std::uint8_t * out
+            );
+        
             /**
              * hex_string
              */
@@ -85,6 +96,18 @@ namespace miner {
                 const std::vector<std::uint8_t> & bytes,
                 const bool & spaces = false
             );
+        
+            /**
+             * Converts an array of bytes into hexidecimal in place (without
+             * allocating).
+             * @param val The value.
+             * @param len The length.
+             * @param out The output (of len * 2 characters).
+             */
+            static void to_hex(
+                const std::uint8_t * val, const std::size_t & len, char * out
+            );
+
             /**
              * Performs le32enc.
              * @param val The value.
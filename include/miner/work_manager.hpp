@@ -21,9 +21,23 @@
 #ifndef MINER_WORK_MANAGER_HPP
 #define MINER_WORK_MANAGER_HPP
 
+#include <atomic>
 #include <cstdint>
+#include <deque>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <set>
+#include <string>
+#include <tuple>
 #include <vector>
 
+#include <boost/asio.hpp>
+
+#include <miner/buffer_pool.hpp>
+#include <miner/share_queue.hpp>
+#include <miner/stratum_probe.hpp>
+
 namespace miner {
 
     class stack_impl;
@@ -56,23 +70,161 @@ namespace miner {
             void stop();
         
             /**
-             * Sets the stratum_work
+             * Sets the stratum_work of a work host, it is only handed to the
+             * devices if the work host is the current one otherwise it is
+             * cached for a failover.
+             * @param work_host_index The work host index.
              * @param val The value.
              */
-            void set_work(const std::shared_ptr<stratum_work> & val);
+            void set_work(
+                const std::uint32_t & work_host_index,
+                const std::shared_ptr<stratum_work> & val
+            );
+        
+            /**
+             * Handles the disconnect of a work host (fails over to a backup
+             * if it is the current one).
+             * @param work_host_index The work host index.
+             */
+            void handle_disconnect(const std::uint32_t & work_host_index);
+        
+            /**
+             * Handles the result of a work host probe.
+             * @param work_host_index The work host index.
+             * @param val The stratum_probe::result_t.
+             */
+            void handle_probe(
+                const std::uint32_t & work_host_index,
+                const stratum_probe::result_t & val
+            );
         
             /**
-             * Submits work with a solution.
+             * Handles the (handshake) round trip times of a work host.
+             * @param work_host_index The work host index.
+             * @param val The stratum_probe::result_t.
+             */
+            void handle_latency(
+                const std::uint32_t & work_host_index,
+                const stratum_probe::result_t & val
+            );
+        
+            /**
+             * Sets the (stratum) session of a work host, it is offered for
+             * resumption when the work host is reconnected.
+             * @param work_host_index The work host index.
+             * @param session_id The session (subscription) id.
+             * @param extranonce1 The extranonce1.
+             * @param extranonce2_size The extranonce2 size.
+             */
+            void set_session(
+                const std::uint32_t & work_host_index,
+                const std::string & session_id,
+                const std::vector<std::uint8_t> & extranonce1,
+                const std::size_t & extranonce2_size
+            );
+        
+            /**
+             * Submits work with a solution (queues a share record to be
+             * formatted and sent by the io_service thread).
              * @param val The work.
              */
             void submit_work(const std::shared_ptr<stratum_work> & val);
         
+            /**
+             * Submits a share (of a downstream miner) to the work host that
+             * issued it's job.
+             * @param val The share_queue::share_t.
+             * @param f The handler (called with the result of the work host
+             * or false if the share could not be submitted).
+             */
+            void submit_share(
+                const share_queue::share_t & val,
+                const std::function<void (const bool &)> & f
+            );
+        
+            /**
+             * If true hashing is split across the (weighted) work hosts.
+             */
+            static bool is_split();
+        
+            /**
+             * Selects the stratum_work of a device when hashing is split
+             * across the work hosts, each device is assigned to a work host
+             * in proportion to the work host weights.
+             * @param works The stratum_work by work host index.
+             * @param device The device index.
+             * @param devices The number of devices.
+             */
+            static std::shared_ptr<stratum_work> split_work(
+                const std::map<std::uint32_t,
+                std::shared_ptr<stratum_work> > & works,
+                const std::size_t & device, const std::size_t & devices
+            );
+        
         private:
         
             /**
-             * Connects to the work server.
+             * Connects to a work server.
+             * @param work_host_index The work host index.
+             */
+            void connect(const std::uint32_t & work_host_index);
+        
+            /**
+             * Connects the current and backup work hosts that are not
+             * connected and stops the ones no longer needed.
+             */
+            void connect_work_hosts();
+        
+            /**
+             * Selects the current work host.
+             * @param work_host_index The work host index.
+             */
+            void select_work_host(const std::uint32_t & work_host_index);
+        
+            /**
+             * Switches to the (lowest) backup work host with cached work.
+             * @param work_host_index The failed work host index.
+             */
+            void failover(const std::uint32_t & work_host_index);
+        
+            /**
+             * If true the work host is connected and mining.
+             * @param work_host_index The work host index.
+             */
+            bool is_mining(const std::uint32_t & work_host_index);
+        
+            /**
+             * The score (smoothed mining.subscribe round trip plus new block
+             * notify delay in microseconds) of a work host, lower is faster.
+             * @param work_host_index The work host index.
+             */
+            std::int64_t score(const std::uint32_t & work_host_index);
+        
+            /**
+             * Records the round trip times of a work host.
+             * @param work_host_index The work host index.
+             * @param val The stratum_probe::result_t.
+             */
+            void record_latency(
+                const std::uint32_t & work_host_index,
+                const stratum_probe::result_t & val
+            );
+        
+            /**
+             * Records the delay of a new block notify of a work host relative
+             * to the first work host that notified it.
+             * @param work_host_index The work host index.
+             * @param val The stratum_work.
+             */
+            void record_notify(
+                const std::uint32_t & work_host_index,
+                const std::shared_ptr<stratum_work> & val
+            );
+        
+            /**
+             * Elects the fastest (mining) work host as the current one.
              */
-            void connect();
+            void elect_work_host();
         
             /**
              * The timer handler.
@@ -81,11 +233,35 @@ namespace miner {
             void tick(const boost::system::error_code & ec);
         
             /**
-             * The check work hosts handler.
+             * The check work hosts handler (probes the work hosts that are
+             * not connected).
              * @param ec The boost::system::error_code.
              */
             void tick_check_work_hosts(const boost::system::error_code & ec);
         
+            /**
+             * Schedules a drain of the share queue (if not already
+             * scheduled).
+             */
+            void post_drain_shares();
+        
+            /**
+             * Drains (a batch of) the share queue formatting and sending the
+             * shares.
+             */
+            void drain_shares();
+        
+            /**
+             * Formats and sends a share to the work host that issued it's job.
+             * @param val The share_queue::share_t.
+             * @param f The handler (of a proxied share).
+             * @return False if the share was dropped.
+             */
+            bool send_share(
+                const share_queue::share_t & val,
+                const std::function<void (const bool &)> & f
+            );
+        
             /**
              * The work.
              */
@@ -111,12 +287,104 @@ namespace miner {
             > timer_;
         
             /**
-             * The stratum connections.
+             * The stratum connections by work host index.
              */
-            std::vector<
-                std::weak_ptr<stratum_connection>
+            std::map<
+                std::uint32_t, std::weak_ptr<stratum_connection>
             > stratum_connections_;
         
+            /**
+             * The latest work by work host index.
+             */
+            std::map<
+                std::uint32_t, std::shared_ptr<stratum_work>
+            > works_;
+        
+            /**
+             * The stratum probes by work host index.
+             */
+            std::map<
+                std::uint32_t, std::weak_ptr<stratum_probe>
+            > stratum_probes_;
+        
+            /**
+             * The latest probe results by work host index.
+             */
+            std::map<std::uint32_t, stratum_probe::result_t> probes_;
+        
+            /**
+             * The latency of a work host (in microseconds).
+             */
+            typedef struct latency_s
+            {
+                latency_s()
+                    : rtt_connect(0)
+                    , rtt_subscribe(0)
+                    , rtt_samples(0)
+                    , notify_delay(0)
+                    , notify_samples(0)
+                {
+                    // ...
+                }
+                
+                std::int64_t rtt_connect;
+                std::int64_t rtt_subscribe;
+                std::uint32_t rtt_samples;
+                std::int64_t notify_delay;
+                std::uint32_t notify_samples;
+            } latency_t;
+        
+            /**
+             * The latencies by work host index.
+             */
+            std::map<std::uint32_t, latency_t> latencies_;
+        
+            /**
+             * A (stratum) session.
+             */
+            typedef struct session_s
+            {
+                std::string id;
+                std::vector<std::uint8_t> extranonce1;
+                std::size_t extranonce2_size;
+            } session_t;
+        
+            /**
+             * The sessions (to resume) by work host index.
+             */
+            std::map<std::uint32_t, session_t> sessions_;
+        
+            /**
+             * The previous hash of the latest work by work host index.
+             */
+            std::map<
+                std::uint32_t, std::vector<std::uint8_t>
+            > previous_hashes_;
+        
+            /**
+             * The recent blocks (previous hashes) and the time they were
+             * first notified.
+             */
+            std::deque<
+                std::pair<std::vector<std::uint8_t>,
+                std::chrono::steady_clock::time_point>
+            > blocks_;
+        
+            /**
+             * The work host that is faster than the current one.
+             */
+            std::uint32_t election_index_;
+        
+            /**
+             * The number of consecutive checks it has been faster.
+             */
+            std::uint32_t election_count_;
+        
+            /**
+             * If true we are stopped (no failover).
+             */
+            std::atomic<bool> stopped_;
+        
             /**
              * The currently selected work host index.
              */
@@ -128,6 +396,66 @@ namespace miner {
             boost::asio::basic_waitable_timer<
                 std::chrono::steady_clock
             > timer_check_work_hosts_;
+        
+            /**
+             * The share queue.
+             */
+            share_queue share_queue_;
+        
+            /**
+             * The buffer_pool (of mining.submit lines).
+             */
+            buffer_pool buffer_pool_;
+        
+            /**
+             * If true a drain of the share queue is scheduled.
+             */
+            std::atomic<bool> drain_shares_pending_;
+        
+            /**
+             * The last job handle.
+             */
+            std::uint32_t job_handle_;
+        
+            /**
+             * The recent jobs by job handle (bounded, a job handle is
+             * assigned to each job_id a work host notifies).
+             */
+            std::map<
+                std::uint32_t, std::shared_ptr<stratum_work>
+            > jobs_;
+        
+            /**
+             * The (clean jobs) generation by work host index, the jobs of
+             * an older generation are stale.
+             */
+            std::map<std::uint32_t, std::uint32_t> generations_;
+        
+            /**
+             * The shares submitted for a job.
+             */
+            typedef struct submitted_s
+            {
+                std::uint32_t job_handle;
+                std::set<std::string> shares;
+            } submitted_t;
+        
+            /**
+             * The shares submitted by work host index, extranonce1 and
+             * job_id as (extranonce2, ntime, nonce) tuples, shared by the
+             * job handles of a re-delivered job so a share is never
+             * submitted twice (a new extranonce1 makes them new shares).
+             */
+            std::map<
+                std::tuple<
+                    std::uint32_t, std::vector<std::uint8_t>, std::string
+                >, submitted_t
+            > submitted_;
+        
+            /**
+             * The jobs std::mutex.
+             */
+            std::mutex mutex_jobs_;
     };
     
 } // namespace miner
@@ -0,0 +1,68 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <atomic>
+
+#include <miner/buffer_pool.hpp>
+
+using namespace miner;
+
+buffer_pool::buffer_pool()
+    : index_(0)
+{
+    buffers_.reserve(max_buffers);
+}
+
+std::shared_ptr<std::string> buffer_pool::acquire()
+{
+    for (std::size_t i = 0; i < buffers_.size(); i++)
+    {
+        auto & buffer = buffers_[(index_ + i) % buffers_.size()];
+        
+        if (buffer.use_count() == 1)
+        {
+            /**
+             * Synchronize with the release of the last writer.
+             */
+            std::atomic_thread_fence(std::memory_order_acquire);
+            
+            index_ = (index_ + i + 1) % buffers_.size();
+            
+            buffer->clear();
+            
+            return buffer;
+        }
+    }
+    
+    auto ret = std::make_shared<std::string> ();
+    
+    ret->reserve(buffer_capacity);
+    
+    /**
+     * Retain the buffer unless the pool is full (then it is freed when
+     * released).
+     */
+    if (buffers_.size() < max_buffers)
+    {
+        buffers_.push_back(ret);
+    }
+    
+    return ret;
+}
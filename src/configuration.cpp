@@ -26,6 +26,19 @@ configuration::configuration()
     : m_device_type(device_type_none)
     , m_proof_of_work_type(proof_of_work_type_none)
     , m_device_cores(1)
+    , m_throttle_hashes_per_second(0.0)
+    , m_throttle_cpu_percent(0.0)
+    , m_throttle_load_average(0.0)
+    , m_sched_idle(false)
+    , m_throttle_temperature(0.0)
+    , m_throttle_watts(0.0)
+    , m_sysfs_root("/sys")
+    , m_io_threads(1)
+    , m_backup_pools(0)
+    , m_pool_selection(pool_selection_order)
+    , m_proxy_port(0)
+    , m_proxy_address("127.0.0.1")
+    , m_share_rate(0.0)
 {
     // ...
 }
@@ -71,12 +84,168 @@ std::vector< std::pair< std::pair<std::string, std::string>,
     return m_work_hosts;
 }
 
+std::vector<configuration::work_host_protocol_t> &
+    configuration::work_host_protocols()
+{
+    return m_work_host_protocols;
+}
+
 void configuration::set_device_cores(const std::uint32_t & val)
 {
     m_device_cores = val;
 }
 
-const std::uint32_t & configuration::device_cores() const
+std::uint32_t configuration::device_cores() const
 {
     return m_device_cores;
 }
+
+void configuration::set_throttle_hashes_per_second(const double & val)
+{
+    m_throttle_hashes_per_second = val;
+}
+
+const double & configuration::throttle_hashes_per_second() const
+{
+    return m_throttle_hashes_per_second;
+}
+
+void configuration::set_throttle_cpu_percent(const double & val)
+{
+    m_throttle_cpu_percent = val;
+}
+
+const double & configuration::throttle_cpu_percent() const
+{
+    return m_throttle_cpu_percent;
+}
+
+void configuration::set_throttle_load_average(const double & val)
+{
+    m_throttle_load_average = val;
+}
+
+const double & configuration::throttle_load_average() const
+{
+    return m_throttle_load_average;
+}
+
+void configuration::set_sched_idle(const bool & val)
+{
+    m_sched_idle = val;
+}
+
+const bool & configuration::sched_idle() const
+{
+    return m_sched_idle;
+}
+
+void configuration::set_throttle_temperature(const double & val)
+{
+    m_throttle_temperature = val;
+}
+
+const double & configuration::throttle_temperature() const
+{
+    return m_throttle_temperature;
+}
+
+void configuration::set_throttle_watts(const double & val)
+{
+    m_throttle_watts = val;
+}
+
+const double & configuration::throttle_watts() const
+{
+    return m_throttle_watts;
+}
+
+void configuration::set_sysfs_root(const std::string & val)
+{
+    m_sysfs_root = val;
+}
+
+const std::string & configuration::sysfs_root() const
+{
+    return m_sysfs_root;
+}
+
+void configuration::set_io_threads(const std::uint32_t & val)
+{
+    m_io_threads = val;
+}
+
+const std::uint32_t & configuration::io_threads() const
+{
+    return m_io_threads;
+}
+
+void configuration::set_io_cores(const std::vector<std::uint32_t> & val)
+{
+    m_io_cores = val;
+}
+
+const std::vector<std::uint32_t> & configuration::io_cores() const
+{
+    return m_io_cores;
+}
+
+void configuration::set_backup_pools(const std::uint32_t & val)
+{
+    m_backup_pools = val;
+}
+
+const std::uint32_t & configuration::backup_pools() const
+{
+    return m_backup_pools;
+}
+
+void configuration::set_pool_selection(const pool_selection_t & val)
+{
+    m_pool_selection = val;
+}
+
+const configuration::pool_selection_t & configuration::pool_selection() const
+{
+    return m_pool_selection;
+}
+
+void configuration::set_work_host_weights(const std::vector<double> & val)
+{
+    m_work_host_weights = val;
+}
+
+const std::vector<double> & configuration::work_host_weights() const
+{
+    return m_work_host_weights;
+}
+
+void configuration::set_proxy_port(const std::uint16_t & val)
+{
+    m_proxy_port = val;
+}
+
+const std::uint16_t & configuration::proxy_port() const
+{
+    return m_proxy_port;
+}
+
+void configuration::set_proxy_address(const std::string & val)
+{
+    m_proxy_address = val;
+}
+
+const std::string & configuration::proxy_address() const
+{
+    return m_proxy_address;
+}
+
+void configuration::set_share_rate(const double & val)
+{
+    m_share_rate = val;
+}
+
+const double & configuration::share_rate() const
+{
+    return m_share_rate;
+}
@@ -18,16 +18,23 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
 #include <chrono>
 #include <iomanip>
 
+#if (defined __linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif // __linux__
+
 #include <miner/configuration.hpp>
 #include <miner/cpu.hpp>
 #include <miner/cpu_handler.hpp>
 #include <miner/hash.hpp>
 #include <miner/logger.hpp>
 #include <miner/stack_impl.hpp>
+#include <miner/statistics.hpp>
 #include <miner/stratum_work.hpp>
 #include <miner/utility.hpp>
 #include <miner/work_manager.hpp>
@@ -41,8 +48,10 @@ cpu::cpu(
     , m_id_maximum(id_max)
     , m_hashes_per_second(0.0)
     , m_hash_counter(0)
+    , m_duty_cycle(1.0)
     , state_(state_none)
     , stack_impl_(owner)
+    , work_epoch_(0)
     , has_new_work_(false)
     , needs_work_restart_(false)
 {
@@ -65,6 +74,8 @@ void cpu::stop()
 {
     log_debug("CPU is stopping.");
     
+    mutex_work_.lock();
+    
     state_ = state_stopped;
     
     /**
@@ -72,6 +83,13 @@ void cpu::stop()
      */
     needs_work_restart_ = true;
     
+    mutex_work_.unlock();
+    
+    /**
+     * Wake the thread if it is waiting for work.
+     */
+    condition_variable_work_.notify_all();
+    
     /**
      * Set the hashes per second.
      */
@@ -110,13 +128,23 @@ void cpu::set_work(const std::shared_ptr<stratum_work> & val)
         
         m_work = val;
         
+        ++work_epoch_;
+        
         mutex_work_.unlock();
     }
     else
     {
         mutex_work_.lock();
         
-        if (m_work == 0 || m_work->job_id() != val->job_id())
+        ++work_epoch_;
+        
+        /**
+         * Job id's are only unique per work host (e.g. after a failover).
+         */
+        if (
+            m_work == 0 || m_work->job_id() != val->job_id() ||
+            m_work->work_host_index() != val->work_host_index()
+            )
         {
             /**
              * Set the work it will then be picked up in the next hashing loop.
@@ -135,22 +163,82 @@ void cpu::set_work(const std::shared_ptr<stratum_work> & val)
         
         mutex_work_.unlock();
     }
+    
+    /**
+     * Wake the thread if it is waiting for work.
+     */
+    condition_variable_work_.notify_all();
+}
+
+void cpu::set_id(const std::uint32_t & id, const std::uint32_t & id_max)
+{
+    std::lock_guard<std::mutex> l1(mutex_work_);
+    
+    if (id != m_id || id_max != m_id_maximum)
+    {
+        m_id = id;
+        m_id_maximum = id_max;
+        
+        /**
+         * Restart the work so the new nonce range is picked up.
+         */
+        needs_work_restart_ = true;
+        
+        condition_variable_work_.notify_all();
+    }
 }
 
 void cpu::loop()
 {
-    std::uint32_t
-        nonce_end = 0xffffffffU / m_id_maximum * (m_id + 1) - 0x20
-    ;
+    std::uint32_t nonce_begin = 0;
+    std::uint32_t nonce_end = 0;
 
     std::srand(static_cast<std::uint32_t> (std::clock()));
     
+#if (defined __linux__)
+    if (configuration::instance().sched_idle())
+    {
+        /**
+         * Only run when the CPU would otherwise be idle.
+         */
+        sched_param param = {};
+        
+        if (pthread_setschedparam(pthread_self(), SCHED_IDLE, &param) != 0)
+        {
+            log_error("CPU failed to set SCHED_IDLE.");
+        }
+    }
+#endif // __linux__
+
+    /**
+     * The (unthrottled) number of hashes per microsecond.
+     */
+    double hashes_per_microsecond = 0.0;
+    
+    /**
+     * The start of the hashes per second measurement.
+     */
+    auto time_counter = std::chrono::steady_clock::now();
+    
+    /**
+     * The notify time of the last work the latency was measured for.
+     */
+    std::chrono::steady_clock::time_point time_notified;
+    
     while (state_ == state_started)
     {
         mutex_work_.lock();
         
         auto work = m_work ? std::make_shared<stratum_work> (*m_work) : 0;
         
+        auto work_epoch = work_epoch_;
+        
+        /**
+         * Calculate the nonce range (the id's may change at runtime).
+         */
+        nonce_begin = 0xffffffffU / m_id_maximum * m_id;
+        nonce_end = 0xffffffffU / m_id_maximum * (m_id + 1) - 0x20;
+        
         mutex_work_.unlock();
         
         /**
@@ -192,20 +280,81 @@ void cpu::loop()
                  */
                 std::uint32_t nonce_max = 0xffff0000;
                 
-                std::int64_t max64 = 60;
-
-                max64 *= m_hashes_per_second;
+                /**
+                 * The duty cycle.
+                 */
+                double duty_cycle = m_duty_cycle;
                 
+                /**
+                 * Scan for one second at a time or 100 milliseconds when
+                 * throttled so the pauses stay short.
+                 */
+                std::int64_t max64 = static_cast<std::int64_t> (
+                    hashes_per_microsecond *
+                    (duty_cycle < 1.0 ? 100000.0 : 1000000.0)
+                );
+                
+                /**
+                 * Until the hash rate is known scan a short calibration
+                 * range.
+                 */
                 if (max64 <= 0)
                 {
-                    max64 = 0xffff0000;
+                    max64 = 0x10000;
                 }
 
                 if (is_new_work)
                 {
                     is_new_work = false;
                     
-                    work->data()[19] = 0xffffffffU / m_id_maximum * m_id;
+                    work->data()[19] = nonce_begin;
+                    
+                    /**
+                     * If the block header was hashed before (e.g. the same
+                     * job was re-delivered after a work restart) resume after
+                     * the last nonce hashed.
+                     */
+                    for (auto & i : nonce_progress_)
+                    {
+                        if (
+                            std::equal(i.header.begin(), i.header.end(),
+                            work->data().begin()) && i.nonce >= nonce_begin &&
+                            i.nonce < nonce_end
+                            )
+                        {
+                            work->data()[19] = i.nonce + 1;
+                            
+                            log_debug(
+                                "CPU is resuming job " << work->job_id() <<
+                                " at nonce " << work->data()[19] << "."
+                            );
+                            
+                            break;
+                        }
+                    }
+                    
+                    /**
+                     * Measure the latency from the notify to the first hash.
+                     */
+                    if (
+                        work->time_notified() != time_notified &&
+                        work->time_notified().time_since_epoch().count() > 0
+                        )
+                    {
+                        time_notified = work->time_notified();
+                        
+                        auto microseconds = std::chrono::duration_cast<
+                            std::chrono::microseconds> (
+                            std::chrono::steady_clock::now() - time_notified
+                        ).count();
+                        
+                        statistics::instance().set_work_latency(microseconds);
+                        
+                        log_debug(
+                            "CPU started hashing " << microseconds <<
+                            " microseconds after notify."
+                        );
+                    }
                 }
                 else
                 {
@@ -226,21 +375,23 @@ void cpu::loop()
                     );
                 }
                 
+                auto time1 = std::chrono::steady_clock::now();
+
                 /**
-                 * Get the milliseconds since epoch.
+                 * The target (a difficulty change is applied to the work
+                 * in place, it is picked up here without a restart).
                  */
-                auto milliseconds1 = std::chrono::duration_cast<
-                    std::chrono::milliseconds> (
-                    std::chrono::system_clock::now().time_since_epoch()
-                ).count();
-
+                std::uint32_t target[8];
+                
+                work->target(target);
+                
                 /**
                  * Scan for a solution to the work.
                  */
                 auto result = hash::scan(
                     configuration::instance().proof_of_work_type(),
                     const_cast<std::uint32_t *>(&work->data()[0]),
-                    work->target(), nonce_max, hashes, nonce,
+                    target, nonce_max, hashes, nonce,
                     needs_work_restart_, has_new_work_
                 );
 
@@ -269,19 +420,63 @@ void cpu::loop()
 
                 m_hash_counter += hashes;
                 
-                auto milliseconds2 = std::chrono::duration_cast<
+                auto time2 = std::chrono::steady_clock::now();
+                
+                auto microseconds = std::chrono::duration_cast<
+                    std::chrono::microseconds> (time2 - time1).count()
+                ;
+                
+                if (microseconds > 0 && hashes > 0)
+                {
+                    hashes_per_microsecond =
+                        static_cast<double> (hashes) / microseconds
+                    ;
+                }
+                
+                /**
+                 * Pause in proportion to the time spent hashing to hold the
+                 * duty cycle.
+                 */
+                if (duty_cycle < 1.0)
+                {
+                    auto pause = std::chrono::microseconds(
+                        static_cast<std::int64_t> (
+                        microseconds * (1.0 - duty_cycle) / duty_cycle)
+                    );
+                    
+                    /**
+                     * Wait (rather than sleep) so new work or a stop wakes
+                     * the thread immediately.
+                     */
+                    std::unique_lock<std::mutex> l1(mutex_work_);
+                    
+                    condition_variable_work_.wait_for(l1,
+                        (std::min)(pause, std::chrono::microseconds(1000000)),
+                        [this, work_epoch]
+                        {
+                            return
+                                state_ != state_started ||
+                                work_epoch_ != work_epoch ||
+                                needs_work_restart_
+                            ;
+                        }
+                    );
+                }
+                
+                auto milliseconds = std::chrono::duration_cast<
                     std::chrono::milliseconds> (
-                    std::chrono::system_clock::now().time_since_epoch()
+                    std::chrono::steady_clock::now() - time_counter
                 ).count();
                 
-                if (milliseconds2 - milliseconds1 > 1000)
+                if (milliseconds > 1000)
                 {
                     m_hashes_per_second =
-                        1000.0 * m_hash_counter /
-                        (milliseconds2 - milliseconds1)
+                        1000.0 * m_hash_counter / milliseconds
                     ;
 
                     m_hash_counter = 0;
+                    
+                    time_counter = std::chrono::steady_clock::now();
 
                     log_info(
                         "CPU hashing " <<
@@ -291,6 +486,37 @@ void cpu::loop()
                 }
             }
             
+            /**
+             * Keep the nonce progress of the block header.
+             */
+            if (is_new_work == false)
+            {
+                std::vector<std::uint32_t> header(
+                    work->data().begin(), work->data().begin() + 19
+                );
+                
+                auto it = nonce_progress_.begin();
+                
+                while (it != nonce_progress_.end())
+                {
+                    if (it->header == header)
+                    {
+                        it = nonce_progress_.erase(it);
+                    }
+                    else
+                    {
+                        ++it;
+                    }
+                }
+                
+                nonce_progress_.push_back({header, work->data()[19]});
+                
+                if (nonce_progress_.size() > max_nonce_progress)
+                {
+                    nonce_progress_.pop_front();
+                }
+            }
+            
             log_info(
                 "CPU " << std::this_thread::get_id() <<
                 " is switching to new work."
@@ -305,11 +531,32 @@ void cpu::loop()
                 "CPU is " << std::this_thread::get_id() << " waiting for work."
             );
             
-            std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+            /**
+             * Wait until the work is set again or we are stopped.
+             */
+            std::unique_lock<std::mutex> l1(mutex_work_);
+            
+            condition_variable_work_.wait(l1,
+                [this, work_epoch]
+                {
+                    return
+                        state_ != state_started || work_epoch_ != work_epoch
+                    ;
+                }
+            );
+            
+            m_hash_counter = 0;
+            
+            time_counter = std::chrono::steady_clock::now();
         }
     }
 }
 
+void cpu::set_duty_cycle(const double & val)
+{
+    m_duty_cycle = (std::max)(0.01, (std::min)(val, 1.0));
+}
+
 const double & cpu::hashes_per_second() const
 {
     return m_hashes_per_second;
@@ -19,41 +19,266 @@
  */
 
 #include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <fstream>
+#include <sstream>
+#include <string>
 #include <thread>
 
+#if (defined __linux__)
+#include <sched.h>
+#endif // __linux__
+
 #include <miner/configuration.hpp>
 #include <miner/cpu.hpp>
 #include <miner/cpu_manager.hpp>
+#include <miner/governor.hpp>
 #include <miner/logger.hpp>
+#include <miner/stack_impl.hpp>
+#include <miner/statistics.hpp>
 #include <miner/stratum_work.hpp>
+#include <miner/work_manager.hpp>
 
 using namespace miner;
 
-cpu_manager::cpu_manager(stack_impl & owner)
-    : stack_impl_(owner)
+#if (defined __linux__)
+
+/**
+ * Reads the CPU bandwidth quota (in cores) of a cgroup directory.
+ * @param path The cgroup directory.
+ * @param v2 If true the directory is a cgroup v2 (unified) directory.
+ * @param cores Set to the number of cores the quota allows.
+ * @return True if a quota is set.
+ */
+static bool read_cgroup_quota(
+    const std::string & path, const bool & v2, double & cores
+    )
 {
-    // ...
+    double quota = -1.0;
+    double period = 0.0;
+    
+    if (v2)
+    {
+        /**
+         * The cpu.max file is "$MAX $PERIOD" where $MAX may be "max".
+         */
+        std::ifstream ifs(path + "/cpu.max");
+        
+        std::string max;
+        
+        if (ifs >> max >> period && max != "max")
+        {
+            /**
+             * An unexpected $MAX is treated as no quota.
+             */
+            std::istringstream iss(max);
+            
+            if (static_cast<bool> (iss >> quota) == false)
+            {
+                quota = -1.0;
+            }
+        }
+    }
+    else
+    {
+        std::ifstream ifs_quota(path + "/cpu.cfs_quota_us");
+        std::ifstream ifs_period(path + "/cpu.cfs_period_us");
+        
+        if ((ifs_quota >> quota && ifs_period >> period) == false)
+        {
+            quota = -1.0;
+        }
+    }
+    
+    if (quota > 0.0 && period > 0.0)
+    {
+        cores = quota / period;
+        
+        return true;
+    }
+    
+    return false;
 }
 
-void cpu_manager::start()
+/**
+ * Reads the (most restrictive) cgroup CPU bandwidth quota of this process
+ * walking from it's cgroup up to the root of the mounted hierarchy.
+ * @param cores Set to the number of cores the quota allows.
+ * @return True if a quota is set.
+ */
+static bool read_cgroup_quota(double & cores)
 {
-    auto device_cores = configuration::instance().device_cores();
+    auto ret = false;
     
-    /**
-     * If the supplied number of device cores is zero, determine the number.
-     */
-    if (device_cores == 0)
+    std::ifstream ifs("/proc/self/cgroup");
+    
+    std::string line;
+    
+    while (std::getline(ifs, line))
     {
         /**
-         * Calculate the number of cores.
+         * The format is "hierarchy-ID:controller-list:cgroup-path".
          */
-        device_cores = (std::max)(
-            static_cast<std::uint32_t> (1),
-            std::thread::hardware_concurrency() - 1
-        );
+        auto pos1 = line.find(':');
+        auto pos2 = line.find(':', pos1 + 1);
+        
+        if (pos1 == std::string::npos || pos2 == std::string::npos)
+        {
+            continue;
+        }
+        
+        auto controllers = line.substr(pos1 + 1, pos2 - pos1 - 1);
+        auto path = line.substr(pos2 + 1);
+        
+        std::vector<std::string> mounts;
+        
+        auto v2 = controllers.empty();
+        
+        if (v2)
+        {
+            mounts.push_back("/sys/fs/cgroup");
+        }
+        else if (
+            ("," + controllers + ",").find(",cpu,") != std::string::npos
+            )
+        {
+            mounts.push_back("/sys/fs/cgroup/cpu,cpuacct");
+            mounts.push_back("/sys/fs/cgroup/cpu");
+        }
+        else
+        {
+            continue;
+        }
+        
+        for (auto & i : mounts)
+        {
+            /**
+             * Inside of a container the hierarchy may be mounted at the
+             * cgroup of the container so also check the root.
+             */
+            for (auto dir = path; ; )
+            {
+                double val = 0.0;
+                
+                if (read_cgroup_quota(i + dir, v2, val))
+                {
+                    if (ret == false || val < cores)
+                    {
+                        cores = val;
+                    }
+                    
+                    ret = true;
+                }
+                
+                if (dir.empty() || dir == "/")
+                {
+                    break;
+                }
+                
+                auto pos = dir.find_last_of('/');
+                
+                dir = pos == std::string::npos ? "" : dir.substr(0, pos);
+            }
+        }
+    }
+    
+    return ret;
+}
+
+/**
+ * Reads the total (system) and the process CPU time in clock ticks.
+ * @param total The total CPU time of all CPU's.
+ * @param process The CPU time of this process.
+ */
+static bool read_cpu_times(std::uint64_t & total, std::uint64_t & process)
+{
+    std::ifstream ifs_stat("/proc/stat");
+    
+    std::string line;
+    
+    if (!std::getline(ifs_stat, line) || line.find("cpu ") != 0)
+    {
+        return false;
+    }
+    
+    std::istringstream iss_stat(line.substr(4));
+    
+    std::uint64_t val = 0;
+    
+    total = 0;
+    
+    while (iss_stat >> val)
+    {
+        total += val;
+    }
+    
+    std::ifstream ifs_self("/proc/self/stat");
+    
+    if (!std::getline(ifs_self, line))
+    {
+        return false;
+    }
+    
+    /**
+     * The fields following the command name, utime and stime are the 14th
+     * and 15th fields (the 12th and 13th after it).
+     */
+    auto pos = line.rfind(')');
+    
+    if (pos == std::string::npos)
+    {
+        return false;
+    }
+    
+    std::istringstream iss_self(line.substr(pos + 1));
+    
+    std::string field;
+    
+    for (auto i = 0; i < 11; i++)
+    {
+        iss_self >> field;
     }
     
+    std::uint64_t utime = 0, stime = 0;
+    
+    if (!(iss_self >> utime >> stime))
+    {
+        return false;
+    }
+    
+    process = utime + stime;
+    
+    return true;
+}
+
+/**
+ * Reads the (one minute) load average.
+ * @param val The value.
+ */
+static bool read_load_average(double & val)
+{
+    std::ifstream ifs("/proc/loadavg");
+    
+    return static_cast<bool> (ifs >> val);
+}
+#endif // __linux__
+
+cpu_manager::cpu_manager(stack_impl & owner)
+    : m_duty_cycle(1.0)
+    , m_cpu_time_total(0)
+    , m_cpu_time_process(0)
+    , stack_impl_(owner)
+    , timer_(owner.io_service())
+    , timer_throttle_(owner.io_service())
+{
+    // ...
+}
+
+void cpu_manager::start()
+{
+    auto device_cores = calculate_device_cores();
+    
     log_info(
         "CPU manager is starting with " << device_cores << " device cores."
     );
@@ -61,60 +286,454 @@ void cpu_manager::start()
     /**
      * Allocate the CPU's.
      */
-    for (auto i = 0; i < device_cores; i++)
+    set_device_cores(device_cores);
+    
+    /**
+     * If the number of device cores is automatic, periodically re-check the
+     * CPU budget so that quota changes adjust the number of CPU's.
+     */
+    if (configuration::instance().device_cores() == 0)
     {
-        auto c = std::make_shared<cpu>(stack_impl_, i, device_cores);
-        
-        m_cpus.push_back(c);
-        
-        c->start();
+        timer_.expires_from_now(std::chrono::seconds(30));
+        timer_.async_wait(std::bind(
+            &cpu_manager::tick, this, std::placeholders::_1)
+        );
     }
+    
+    /**
+     * Allocate the governor.
+     */
+    m_governor = std::make_shared<governor> (
+        configuration::instance().sysfs_root()
+    );
+    
+    /**
+     * Start the throttle timer.
+     */
+    timer_throttle_.expires_from_now(std::chrono::seconds(1));
+    timer_throttle_.async_wait(std::bind(
+        &cpu_manager::tick_throttle, this, std::placeholders::_1)
+    );
 }
 
 void cpu_manager::stop()
 {
-    log_debug("CPU manager is starting.");
+    log_debug("CPU manager is stopping.");
+    
+    timer_.cancel();
+    timer_throttle_.cancel();
+    
+    std::vector< std::shared_ptr<cpu> > cpus;
+    
+    std::vector<std::thread> threads_stop;
+    
+    mutex_.lock();
+    
+    cpus.swap(m_cpus);
+    
+    threads_stop.swap(threads_stop_);
+    
+    mutex_.unlock();
     
     /**
      * Stop the CPU's.
      */
-    for (auto & i : m_cpus)
+    for (auto & i : cpus)
     {
         i->stop();
     }
+    
+    /**
+     * Wait for the removed CPU's to stop.
+     */
+    for (auto & i : threads_stop)
+    {
+        i.join();
+    }
 }
 
 void cpu_manager::set_work(const std::shared_ptr<stratum_work> & val)
 {
     log_debug("CPU manager is setting work.");
     
+    std::lock_guard<std::mutex> l1(mutex_);
+    
+    m_work = val;
+    
+    m_works.clear();
+    
+    /**
+     * Inform all CPU's of the new work.
+     */
+    for (auto & i : m_cpus)
+    {
+        i->set_work(m_work);
+    }
+}
+
+void cpu_manager::set_works(
+    const std::map<std::uint32_t, std::shared_ptr<stratum_work> > & val
+    )
+{
+    log_debug("CPU manager is setting works.");
+    
+    std::lock_guard<std::mutex> l1(mutex_);
+    
+    m_works = val;
+    
+    /**
+     * Assign each CPU the work of a work host.
+     */
+    for (std::size_t i = 0; i < m_cpus.size(); i++)
+    {
+        m_cpus[i]->set_work(
+            work_manager::split_work(m_works, i, m_cpus.size())
+        );
+    }
+}
+
+void cpu_manager::set_device_cores(const std::uint32_t & val)
+{
     if (val == 0)
     {
-        m_work = val;
+        return;
+    }
+    
+    std::vector< std::shared_ptr<cpu> > cpus;
+    
+    mutex_.lock();
+    
+    /**
+     * Remove the CPU's beyond the new number of device cores.
+     */
+    if (val < m_cpus.size())
+    {
+        cpus.assign(m_cpus.begin() + val, m_cpus.end());
+        
+        m_cpus.resize(val);
+    }
+    
+    /**
+     * Re-partition the nonce range of the remaining CPU's.
+     */
+    for (std::size_t i = 0; i < m_cpus.size(); i++)
+    {
+        m_cpus[i]->set_id(i, val);
+    }
+    
+    /**
+     * Allocate the additional CPU's.
+     */
+    for (auto i = m_cpus.size(); i < val; i++)
+    {
+        auto c = std::make_shared<cpu>(stack_impl_, i, val);
+        
+        m_cpus.push_back(c);
+        
+        c->set_duty_cycle(m_duty_cycle);
+        
+        c->start();
         
         /**
-         * Inform all CPU's of the new work.
+         * Give the CPU the current work (if any).
          */
-        for (auto & i : m_cpus)
+        if (m_works.size() == 0 && m_work)
         {
-            i->set_work(m_work);
+            c->set_work(m_work);
         }
     }
-    else
+    
+    /**
+     * Re-assign the CPU's to the work hosts.
+     */
+    if (m_works.size() > 0)
+    {
+        for (std::size_t i = 0; i < m_cpus.size(); i++)
+        {
+            m_cpus[i]->set_work(
+                work_manager::split_work(m_works, i, m_cpus.size())
+            );
+        }
+    }
+    
+    /**
+     * Stop the removed CPU's on another thread (joining them waits for the
+     * current scan to finish which would block the io_service), they are
+     * joined in stop.
+     */
+    if (cpus.size() > 0)
     {
-        m_work = val;
+        threads_stop_.push_back(std::thread(
+            [cpus] ()
+            {
+                for (auto & i : cpus)
+                {
+                    i->stop();
+                }
+            })
+        );
+    }
+    
+    mutex_.unlock();
+    
+    log_info("CPU manager is running " << val << " device cores.");
+}
+
+std::uint32_t cpu_manager::device_cores()
+{
+    std::lock_guard<std::mutex> l1(mutex_);
+    
+    return static_cast<std::uint32_t> (m_cpus.size());
+}
+
+const std::vector< std::shared_ptr<cpu> > & cpu_manager::cpus() const
+{
+    return m_cpus;
+}
+
+double cpu_manager::hashes_per_second()
+{
+    double ret = 0.0;
+    
+    std::lock_guard<std::mutex> l1(mutex_);
+    
+    for (auto & i : m_cpus)
+    {
+        ret += i->hashes_per_second();
+    }
+    
+    return ret;
+}
+
+std::uint32_t cpu_manager::available_cores()
+{
+    std::uint32_t ret = std::thread::hardware_concurrency();
+    
+#if (defined __linux__)
+    /**
+     * The scheduler affinity reflects the effective cpuset.
+     */
+    cpu_set_t cpuset;
+    
+    CPU_ZERO(&cpuset);
+    
+    if (sched_getaffinity(0, sizeof(cpuset), &cpuset) == 0)
+    {
+        auto count = CPU_COUNT(&cpuset);
         
+        if (count > 0)
+        {
+            ret = static_cast<std::uint32_t> (count);
+        }
+    }
+    
+    double cores = 0.0;
+    
+    if (read_cgroup_quota(cores))
+    {
+        /**
+         * Round up, a fractional quota still allows a (throttled) core.
+         */
+        auto quota_cores = static_cast<std::uint32_t> (std::ceil(cores));
+        
+        log_debug(
+            "CPU manager got cgroup CPU quota = " << cores << " cores."
+        );
+        
+        ret = (std::min)(ret, (std::max)(quota_cores, 1u));
+    }
+#endif // __linux__
+
+    return (std::max)(ret, 1u);
+}
+
+std::uint32_t cpu_manager::calculate_device_cores()
+{
+    auto device_cores = configuration::instance().device_cores();
+    
+    /**
+     * If the supplied number of device cores is zero, determine the number.
+     */
+    if (device_cores == 0)
+    {
         /**
-         * Inform all CPU's of the new work.
+         * Calculate the number of cores leaving one for each io_service
+         * thread.
          */
-        for (auto & i : m_cpus)
+        auto io_threads = (std::max)(
+            static_cast<std::uint32_t> (1),
+            configuration::instance().io_threads()
+        );
+        
+        device_cores = available_cores() > io_threads ?
+            available_cores() - io_threads : 1
+        ;
+    }
+    
+    return device_cores;
+}
+
+void cpu_manager::tick(const boost::system::error_code & ec)
+{
+    if (ec)
+    {
+        // ...
+    }
+    else if (configuration::instance().device_cores() == 0)
+    {
+        auto device_cores = calculate_device_cores();
+        
+        /**
+         * The number of CPU's is read under the lock (they may be resized
+         * by stack_impl::set_device_cores).
+         */
+        auto cpus = this->device_cores();
+        
+        if (device_cores != cpus)
         {
-            i->set_work(m_work);
+            log_info(
+                "CPU manager CPU budget changed, switching from " <<
+                cpus << " to " << device_cores << " device cores."
+            );
+            
+            set_device_cores(device_cores);
         }
+        
+        timer_.expires_from_now(std::chrono::seconds(30));
+        timer_.async_wait(std::bind(
+            &cpu_manager::tick, this, std::placeholders::_1)
+        );
     }
 }
 
-const std::vector< std::shared_ptr<cpu> > & cpu_manager::cpus() const
+void cpu_manager::tick_throttle(const boost::system::error_code & ec)
 {
-    return m_cpus;
+    if (ec)
+    {
+        // ...
+    }
+    else
+    {
+        const auto & config = configuration::instance();
+        
+        /**
+         * Each target proposes a duty cycle, the lowest wins. The hash rate
+         * and CPU usage respond immediately while the load average is an
+         * exponential average so it is approached more slowly.
+         */
+        auto duty_cycle = 1.0;
+        
+        auto propose = [&](const double & ratio, const double & gain)
+        {
+            auto r = (std::max)(0.5, (std::min)(ratio, 2.0));
+            
+            duty_cycle = (std::min)(
+                duty_cycle,
+                m_duty_cycle + gain * (m_duty_cycle * r - m_duty_cycle)
+            );
+        };
+        
+        if (config.throttle_hashes_per_second() > 0.0)
+        {
+            auto val = hashes_per_second();
+            
+            if (val > 0.0)
+            {
+                propose(config.throttle_hashes_per_second() / val, 0.5);
+            }
+            else
+            {
+                duty_cycle = (std::min)(duty_cycle, m_duty_cycle);
+            }
+        }
+        
+#if (defined __linux__)
+        if (config.throttle_cpu_percent() > 0.0)
+        {
+            std::uint64_t total = 0, process = 0;
+            
+            if (read_cpu_times(total, process))
+            {
+                if (total > m_cpu_time_total && m_cpu_time_total > 0)
+                {
+                    auto percent =
+                        100.0 * (process - m_cpu_time_process) /
+                        (total - m_cpu_time_total)
+                    ;
+                    
+                    propose(
+                        config.throttle_cpu_percent() /
+                        (std::max)(percent, 0.01), 0.5
+                    );
+                }
+                else
+                {
+                    duty_cycle = (std::min)(duty_cycle, m_duty_cycle);
+                }
+                
+                m_cpu_time_total = total;
+                m_cpu_time_process = process;
+            }
+        }
+        
+        if (config.throttle_load_average() > 0.0)
+        {
+            double load_average = 0.0;
+            
+            if (read_load_average(load_average) && load_average > 0.0)
+            {
+                propose(
+                    config.throttle_load_average() / load_average, 0.1
+                );
+            }
+        }
+#endif // __linux__
+
+        /**
+         * Sample the thermal zones and RAPL energy counters.
+         */
+        m_governor->sample();
+        
+        statistics::instance().set_temperature(m_governor->temperature());
+        statistics::instance().set_watts(m_governor->watts());
+        
+        if (
+            config.throttle_temperature() > 0.0 &&
+            m_governor->temperature() > 0.0
+            )
+        {
+            propose(
+                config.throttle_temperature() / m_governor->temperature(),
+                0.25
+            );
+        }
+        
+        if (config.throttle_watts() > 0.0 && m_governor->watts() > 0.0)
+        {
+            propose(config.throttle_watts() / m_governor->watts(), 0.5);
+        }
+        
+        duty_cycle = (std::max)(0.01, (std::min)(duty_cycle, 1.0));
+        
+        if (duty_cycle != m_duty_cycle)
+        {
+            log_debug(
+                "CPU manager is setting duty cycle = " << duty_cycle << "."
+            );
+            
+            std::lock_guard<std::mutex> l1(mutex_);
+            
+            m_duty_cycle = duty_cycle;
+            
+            for (auto & i : m_cpus)
+            {
+                i->set_duty_cycle(m_duty_cycle);
+            }
+        }
+        
+        timer_throttle_.expires_from_now(std::chrono::seconds(1));
+        timer_throttle_.async_wait(std::bind(
+            &cpu_manager::tick_throttle, this, std::placeholders::_1)
+        );
+    }
 }
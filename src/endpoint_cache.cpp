@@ -0,0 +1,92 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <miner/endpoint_cache.hpp>
+#include <miner/logger.hpp>
+
+using namespace miner;
+
+endpoint_cache::endpoint_cache()
+{
+    // ...
+}
+
+endpoint_cache & endpoint_cache::instance()
+{
+    static endpoint_cache g_endpoint_cache;
+    
+    return g_endpoint_cache;
+}
+
+bool endpoint_cache::find(
+    const std::string & host, const std::uint16_t & port,
+    std::vector<boost::asio::ip::tcp::endpoint> & val
+    )
+{
+    std::lock_guard<std::mutex> l1(mutex_entries_);
+    
+    auto it = entries_.find(host + ":" + std::to_string(port));
+    
+    if (it != entries_.end())
+    {
+        if (std::chrono::steady_clock::now() < it->second.time_expires)
+        {
+            val = it->second.endpoints;
+            
+            return true;
+        }
+        
+        entries_.erase(it);
+    }
+    
+    return false;
+}
+
+void endpoint_cache::insert(
+    const std::string & host, const std::uint16_t & port,
+    const std::vector<boost::asio::ip::tcp::endpoint> & val
+    )
+{
+    if (val.size() > 0)
+    {
+        std::lock_guard<std::mutex> l1(mutex_entries_);
+        
+        auto & entry = entries_[host + ":" + std::to_string(port)];
+        
+        entry.endpoints = val;
+        entry.time_expires =
+            std::chrono::steady_clock::now() + std::chrono::seconds(ttl)
+        ;
+    }
+}
+
+void endpoint_cache::erase(
+    const std::string & host, const std::uint16_t & port
+    )
+{
+    std::lock_guard<std::mutex> l1(mutex_entries_);
+    
+    if (entries_.erase(host + ":" + std::to_string(port)) > 0)
+    {
+        log_debug(
+            "Endpoint cache erased " << host << ":" << port << "."
+        );
+    }
+}
@@ -0,0 +1,151 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <fstream>
+
+#include <miner/governor.hpp>
+#include <miner/logger.hpp>
+
+using namespace miner;
+
+governor::governor(const std::string & sysfs_root)
+    : m_sysfs_root(sysfs_root)
+    , m_temperature(0.0)
+    , m_watts(0.0)
+{
+    // ...
+}
+
+void governor::sample()
+{
+    /**
+     * The thermal zones report millidegrees Celsius.
+     */
+    double temperature = 0.0;
+    
+    for (auto i = 0; ; i++)
+    {
+        std::uint64_t val = 0;
+        
+        if (
+            read(m_sysfs_root + "/class/thermal/thermal_zone" +
+            std::to_string(i) + "/temp", val) == false
+            )
+        {
+            break;
+        }
+        
+        if (val / 1000.0 > temperature)
+        {
+            temperature = val / 1000.0;
+        }
+    }
+    
+    m_temperature = temperature;
+    
+    /**
+     * The RAPL packages report a (wrapping) microjoule counter, the
+     * sub-domains (intel-rapl:N:M) are part of their package so only the
+     * packages are summed.
+     */
+    auto now = std::chrono::steady_clock::now();
+    
+    auto seconds = std::chrono::duration_cast<
+        std::chrono::duration<double> > (now - m_time).count()
+    ;
+    
+    double joules = 0.0;
+    
+    auto sampled = false;
+    
+    for (auto i = 0; ; i++)
+    {
+        auto path =
+            m_sysfs_root + "/class/powercap/intel-rapl:" + std::to_string(i)
+        ;
+        
+        std::uint64_t energy = 0;
+        
+        if (read(path + "/energy_uj", energy) == false)
+        {
+            break;
+        }
+        
+        auto it = m_energy.find(path);
+        
+        if (it != m_energy.end())
+        {
+            auto delta = energy - it->second;
+            
+            auto valid = true;
+            
+            if (energy < it->second)
+            {
+                std::uint64_t range = 0;
+                
+                /**
+                 * Without a (sane) range the wrapped delta is unknown so
+                 * this package is skipped until the next sample.
+                 */
+                valid =
+                    read(path + "/max_energy_range_uj", range) &&
+                    range >= it->second
+                ;
+                
+                delta = range - it->second + energy;
+            }
+            
+            if (valid)
+            {
+                joules += delta / 1000000.0;
+                
+                sampled = true;
+            }
+        }
+        
+        m_energy[path] = energy;
+    }
+    
+    m_watts = sampled && seconds > 0.0 ? joules / seconds : 0.0;
+    
+    m_time = now;
+    
+    log_debug(
+        "Governor sampled temperature = " << m_temperature << "C, power = " <<
+        m_watts << "W."
+    );
+}
+
+const double & governor::temperature() const
+{
+    return m_temperature;
+}
+
+const double & governor::watts() const
+{
+    return m_watts;
+}
+
+bool governor::read(const std::string & path, std::uint64_t & val)
+{
+    std::ifstream ifs(path);
+    
+    return static_cast<bool> (ifs >> val);
+}
@@ -47,6 +47,7 @@ gpu::gpu(
     , m_hash_counter(0)
     , state_(state_none)
     , stack_impl_(owner)
+    , work_epoch_(0)
     , has_new_work_(false)
     , needs_work_restart_(false)
 {
@@ -91,6 +92,8 @@ void gpu::stop()
 {
     log_debug("GPU is stopping.");
     
+    mutex_work_.lock();
+    
     state_ = state_stopped;
     
     /**
@@ -98,6 +101,13 @@ void gpu::stop()
      */
     needs_work_restart_ = true;
     
+    mutex_work_.unlock();
+    
+    /**
+     * Wake the thread if it is waiting for work.
+     */
+    condition_variable_work_.notify_all();
+    
     /**
      * Set the hashes per second.
      */
@@ -136,6 +146,8 @@ void gpu::set_work(const std::shared_ptr<stratum_work> & val)
         
         m_work = val;
         
+        ++work_epoch_;
+        
         mutex_work_.unlock();
         
         if (m_gpu_handler)
@@ -147,7 +159,15 @@ void gpu::set_work(const std::shared_ptr<stratum_work> & val)
     {
         mutex_work_.lock();
         
-        if (m_work == 0 || m_work->job_id() != val->job_id())
+        ++work_epoch_;
+        
+        /**
+         * Job id's are only unique per work host (e.g. after a failover).
+         */
+        if (
+            m_work == 0 || m_work->job_id() != val->job_id() ||
+            m_work->work_host_index() != val->work_host_index()
+            )
         {
             /**
              * Set the work it will then be picked up in the next hashing loop.
@@ -171,6 +191,11 @@ void gpu::set_work(const std::shared_ptr<stratum_work> & val)
         
         mutex_work_.unlock();
     }
+    
+    /**
+     * Wake the thread if it is waiting for work.
+     */
+    condition_variable_work_.notify_all();
 }
 
 void gpu::loop()
@@ -185,12 +210,24 @@ void gpu::loop()
     
     while (state_ == state_started)
     {
+        std::unique_lock<std::mutex> l1(mutex_work_);
+        
+        auto work_epoch = work_epoch_;
+        
         if (m_gpu_handler)
         {
             // ...
         }
         
-        std::this_thread::sleep_for(std::chrono::milliseconds(1000));
+        /**
+         * Wait until the work is set again or we are stopped.
+         */
+        condition_variable_work_.wait(l1,
+            [this, work_epoch]
+            {
+                return state_ != state_started || work_epoch_ != work_epoch;
+            }
+        );
     }
 }
 
@@ -122,9 +122,10 @@ bool hash::scan_whirlpool_xor(
         );
  
         /**
-         * First check.
+         * First check (the most significant word can not exceed the
+         * target's).
          */
-        if ((hash64[7] & 0xFFFFFF00) == 0 && check_hash(hash64, ptr_target))
+        if (hash64[7] <= ptr_target[7] && check_hash(hash64, ptr_target))
         {
             hashes_done = nonce - first_nonce + 1;
 
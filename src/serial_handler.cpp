@@ -30,7 +30,7 @@ using namespace miner;
 
 serial_handler::serial_handler(std::shared_ptr<serial_port> & owner)
     : serial_port_(owner)
-    , strand_(owner->io_service())
+    , strand_(owner->strand())
 {
     // ...
 }
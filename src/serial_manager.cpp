@@ -24,6 +24,7 @@
 #include <miner/serial_port.hpp>
 #include <miner/stack_impl.hpp>
 #include <miner/stratum_work.hpp>
+#include <miner/work_manager.hpp>
 
 using namespace miner;
 
@@ -101,6 +102,26 @@ void serial_manager::set_work(const std::shared_ptr<stratum_work> & val)
     }
 }
 
+void serial_manager::set_works(
+    const std::map<std::uint32_t, std::shared_ptr<stratum_work> > & val
+    )
+{
+    log_debug("Serial manager set works.");
+    
+    /**
+     * Assign each serial port the work of a work host.
+     */
+    for (std::size_t i = 0; i < m_serial_ports.size(); i++)
+    {
+        if (auto j = m_serial_ports[i].lock())
+        {
+            j->set_work(
+                work_manager::split_work(val, i, m_serial_ports.size())
+            );
+        }
+    }
+}
+
 const std::vector< std::weak_ptr<serial_port> > &
     serial_manager::serial_ports() const
 {
@@ -122,8 +122,8 @@ bool serial_port::open(const std::string & device)
     }
     
     timer_.expires_from_now(std::chrono::seconds(8));
-    timer_.async_wait(std::bind(
-        &serial_port::tick, shared_from_this(), std::placeholders::_1)
+    timer_.async_wait(strand_.wrap(std::bind(
+        &serial_port::tick, shared_from_this(), std::placeholders::_1))
     );
     
     return true;
@@ -179,6 +179,11 @@ boost::asio::io_service & serial_port::io_service()
     return stack_impl_.io_service();
 }
 
+boost::asio::strand & serial_port::strand()
+{
+    return strand_;
+}
+
 void serial_port::set_work(const std::shared_ptr<stratum_work> & val)
 {
     log_info("Serial port " << this << " got new work.");
@@ -210,7 +215,13 @@ void serial_port::set_work(const std::shared_ptr<stratum_work> & val)
     {
         mutex_work_.lock();
         
-        if (m_work == 0 || m_work->job_id() != val->job_id())
+        /**
+         * Job id's are only unique per work host (e.g. after a failover).
+         */
+        if (
+            m_work == 0 || m_work->job_id() != val->job_id() ||
+            m_work->work_host_index() != val->work_host_index()
+            )
         {
             /**
              * Set the work it will then be picked up in the next hashing loop.
@@ -263,7 +274,8 @@ void serial_port::do_read()
     auto self(shared_from_this());
 
     m_serial_port.async_read_some(boost::asio::buffer(read_buffer_),
-        [this, self](boost::system::error_code ec, std::size_t len)
+        strand_.wrap([this, self](
+        boost::system::error_code ec, std::size_t len)
         {
             if (ec)
             {
@@ -288,7 +300,7 @@ void serial_port::do_read()
                  */
                 do_read();
             }
-        }
+        })
     );
 }
 
@@ -298,7 +310,7 @@ void serial_port::do_write(const char * buf, const std::size_t & len)
     
     m_serial_port.async_write_some(
         boost::asio::buffer(buf, len),
-        [this, self](boost::system::error_code ec,
+        strand_.wrap([this, self](boost::system::error_code ec,
         std::size_t bytes_transferred)
         {
             if (ec)
@@ -327,7 +339,7 @@ void serial_port::do_write(const char * buf, const std::size_t & len)
                     );
                 }
             }
-        }
+        })
     );
 }
 
@@ -350,8 +362,8 @@ void serial_port::tick(const boost::system::error_code & ec)
         else
         {
             timer_.expires_from_now(std::chrono::seconds(8));
-            timer_.async_wait(std::bind(
-                &serial_port::tick, shared_from_this(), std::placeholders::_1)
+            timer_.async_wait(strand_.wrap(std::bind(
+                &serial_port::tick, shared_from_this(), std::placeholders::_1))
             );
         }
     }
@@ -0,0 +1,114 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <miner/share_queue.hpp>
+
+using namespace miner;
+
+share_queue::share_queue()
+    : m_enqueue_position(0)
+    , m_dequeue_position(0)
+{
+    for (std::size_t i = 0; i < capacity; i++)
+    {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+    }
+}
+
+bool share_queue::push(const share_t & val)
+{
+    cell_t * cell = 0;
+    
+    auto position = m_enqueue_position.load(std::memory_order_relaxed);
+    
+    for (;;)
+    {
+        cell = &m_cells[position & (capacity - 1)];
+        
+        auto sequence = cell->sequence.load(std::memory_order_acquire);
+        
+        auto diff =
+            static_cast<std::intptr_t> (sequence) -
+            static_cast<std::intptr_t> (position)
+        ;
+        
+        if (diff == 0)
+        {
+            /**
+             * The cell is free, try to claim it.
+             */
+            if (
+                m_enqueue_position.compare_exchange_weak(
+                position, position + 1, std::memory_order_relaxed)
+                )
+            {
+                break;
+            }
+        }
+        else if (diff < 0)
+        {
+            /**
+             * The queue is full.
+             */
+            return false;
+        }
+        else
+        {
+            position = m_enqueue_position.load(std::memory_order_relaxed);
+        }
+    }
+    
+    cell->share = val;
+    
+    /**
+     * Publish the cell to the consumer.
+     */
+    cell->sequence.store(position + 1, std::memory_order_release);
+    
+    return true;
+}
+
+bool share_queue::pop(share_t & val)
+{
+    auto & cell = m_cells[m_dequeue_position & (capacity - 1)];
+    
+    auto sequence = cell.sequence.load(std::memory_order_acquire);
+    
+    if (sequence != m_dequeue_position + 1)
+    {
+        /**
+         * The queue is empty (or the cell is not yet published).
+         */
+        return false;
+    }
+    
+    val = cell.share;
+    
+    /**
+     * Release the cell to the producers.
+     */
+    cell.sequence.store(
+        m_dequeue_position + capacity, std::memory_order_release
+    );
+    
+    ++m_dequeue_position;
+    
+    return true;
+}
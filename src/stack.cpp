@@ -68,3 +68,29 @@ void stack::stop()
         throw std::runtime_error("Stack is not allocated");
     }
 }
+
+void stack::set_device_cores(const std::uint32_t & val)
+{
+    if (stack_impl_)
+    {
+        stack_impl_->set_device_cores(val);
+    }
+}
+
+void stack::adjust_device_cores(const std::int32_t & delta)
+{
+    if (stack_impl_)
+    {
+        stack_impl_->adjust_device_cores(delta);
+    }
+}
+
+std::uint32_t stack::device_cores()
+{
+    if (stack_impl_)
+    {
+        return stack_impl_->device_cores();
+    }
+    
+    return 0;
+}
@@ -18,6 +18,11 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#if (defined __linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif // __linux__
+
 #include <boost/algorithm/string.hpp>
 
 #include <miner/configuration.hpp>
@@ -32,6 +37,7 @@
 #include <miner/stack_impl.hpp>
 #include <miner/statistics.hpp>
 #include <miner/stratum.hpp>
+#include <miner/stratum_server.hpp>
 #include <miner/stratum_work.hpp>
 #include <miner/work_manager.hpp>
 
@@ -62,16 +68,23 @@ void stack_impl::start(const std::map<std::string, std::string> & args)
     work_.reset(new boost::asio::io_service::work(m_io_service));
 
     /**
-     * Allocate the thread.
+     * Allocate the io_service threads, all handlers of a given object are
+     * serialized by it's boost::asio::strand.
      */
-    auto thread = std::make_shared<std::thread> (
-        std::bind(&stack_impl::loop, this)
-    );
-    
-    /**
-     * Retain the thread.
-     */
-    threads_.push_back(thread);
+    for (std::uint32_t i = 0; i < configuration::instance().io_threads(); i++)
+    {
+        /**
+         * Allocate the thread.
+         */
+        auto thread = std::make_shared<std::thread> (
+            std::bind(&stack_impl::loop, this, i)
+        );
+        
+        /**
+         * Retain the thread.
+         */
+        threads_.push_back(thread);
+    }
 
     /**
      * Check the device type.
@@ -122,6 +135,22 @@ void stack_impl::start(const std::map<std::string, std::string> & args)
         m_serial_manager->start();
     }
     
+    if (configuration::instance().proxy_port() > 0)
+    {
+        /**
+         * Allocate the stratum_server.
+         */
+        m_stratum_server = std::make_shared<stratum_server>(*this);
+        
+        /**
+         * Start the stratum_server.
+         */
+        m_stratum_server->start(
+            configuration::instance().proxy_address(),
+            configuration::instance().proxy_port()
+        );
+    }
+    
     /**
      * Allocate the work manager.
      */
@@ -135,6 +164,13 @@ void stack_impl::start(const std::map<std::string, std::string> & args)
 
 void stack_impl::stop()
 {
+    auto submits = statistics::instance().submits_report();
+    
+    if (submits.size() > 0)
+    {
+        log_info("Stack mining.submit statistics:" << submits);
+    }
+    
     if (m_cpu_manager)
     {
         m_cpu_manager->stop();
@@ -155,6 +191,11 @@ void stack_impl::stop()
         m_work_manager->stop();
     }
     
+    if (m_stratum_server)
+    {
+        m_stratum_server->stop();
+    }
+    
     /**
      * Reset the work.
      */
@@ -207,6 +248,162 @@ void stack_impl::parse_command_line_args(
             
             configuration::instance().set_device_cores(device_cores);
         }
+        else if (i.first == "throttle-hashrate")
+        {
+            auto val = std::stod(i.second);
+            
+            log_info("Stack got throttle hashrate = " << val << " H/s.");
+            
+            configuration::instance().set_throttle_hashes_per_second(val);
+        }
+        else if (i.first == "throttle-cpu")
+        {
+            auto val = std::stod(i.second);
+            
+            log_info("Stack got throttle CPU = " << val << "%.");
+            
+            configuration::instance().set_throttle_cpu_percent(val);
+        }
+        else if (i.first == "throttle-load")
+        {
+            auto val = std::stod(i.second);
+            
+            log_info("Stack got throttle load average = " << val << ".");
+            
+            configuration::instance().set_throttle_load_average(val);
+        }
+        else if (i.first == "throttle-temperature")
+        {
+            auto val = std::stod(i.second);
+            
+            log_info("Stack got throttle temperature = " << val << "C.");
+            
+            configuration::instance().set_throttle_temperature(val);
+        }
+        else if (i.first == "throttle-watts")
+        {
+            auto val = std::stod(i.second);
+            
+            log_info("Stack got throttle watts = " << val << "W.");
+            
+            configuration::instance().set_throttle_watts(val);
+        }
+        else if (i.first == "sysfs-root")
+        {
+            log_info("Stack got sysfs root = " << i.second << ".");
+            
+            configuration::instance().set_sysfs_root(i.second);
+        }
+        else if (i.first == "io-threads")
+        {
+            auto val = std::stoi(i.second);
+            
+            log_info("Stack got io threads = " << val << ".");
+            
+            configuration::instance().set_io_threads(
+                static_cast<std::uint32_t> (std::max(val, 1))
+            );
+        }
+        else if (i.first == "io-cores")
+        {
+            std::vector<std::string> parts;
+            
+            boost::split(parts, i.second, boost::is_any_of(","));
+            
+            std::vector<std::uint32_t> cores;
+            
+            for (auto & j : parts)
+            {
+                if (j.size() > 0)
+                {
+                    cores.push_back(std::stoi(j));
+                }
+            }
+            
+            log_info("Stack got io cores = " << i.second << ".");
+            
+            configuration::instance().set_io_cores(cores);
+        }
+        else if (i.first == "backup-pools")
+        {
+            auto val = std::stoi(i.second);
+            
+            log_info("Stack got backup pools = " << val << ".");
+            
+            configuration::instance().set_backup_pools(
+                static_cast<std::uint32_t> (std::max(val, 0))
+            );
+        }
+        else if (i.first == "pool-selection")
+        {
+            log_info("Stack got pool selection = " << i.second << ".");
+            
+            if (i.second == "order")
+            {
+                configuration::instance().set_pool_selection(
+                    configuration::pool_selection_order
+                );
+            }
+            else if (i.second == "latency")
+            {
+                configuration::instance().set_pool_selection(
+                    configuration::pool_selection_latency
+                );
+            }
+            else
+            {
+                throw std::runtime_error("invalid pool selection");
+            }
+        }
+        else if (i.first == "pool-weights")
+        {
+            std::vector<std::string> parts;
+            
+            boost::split(parts, i.second, boost::is_any_of(","));
+            
+            std::vector<double> weights;
+            
+            for (auto & j : parts)
+            {
+                weights.push_back(j.size() > 0 ? std::stod(j) : 0.0);
+            }
+            
+            log_info("Stack got pool weights = " << i.second << ".");
+            
+            configuration::instance().set_work_host_weights(weights);
+        }
+        else if (i.first == "proxy-port")
+        {
+            auto val = std::stoi(i.second);
+            
+            log_info("Stack got proxy port = " << val << ".");
+            
+            configuration::instance().set_proxy_port(
+                static_cast<std::uint16_t> (std::max(val, 0))
+            );
+        }
+        else if (i.first == "proxy-address")
+        {
+            log_info("Stack got proxy address = " << i.second << ".");
+            
+            configuration::instance().set_proxy_address(i.second);
+        }
+        else if (i.first == "share-rate")
+        {
+            auto val = std::stod(i.second);
+            
+            log_info("Stack got share rate = " << val << ".");
+            
+            configuration::instance().set_share_rate(std::max(val, 0.0));
+        }
+        else if (i.first == "sched-idle")
+        {
+            auto val = std::stoi(i.second) != 0;
+            
+            log_info("Stack got sched idle = " << val << ".");
+            
+            configuration::instance().set_sched_idle(val);
+        }
         else if (i.first == "device-type")
         {
             log_info("Stack got device type = " << i.second << ".");
@@ -276,8 +473,17 @@ void stack_impl::parse_command_line_args(
             {
                 auto pos = i.find("stratum+tcp://");
                 
+                auto protocol = configuration::work_host_protocol_stratum;
+                
+                if (pos == std::string::npos)
+                {
+                    pos = i.find("stratum2+tcp://");
+                    
+                    protocol = configuration::work_host_protocol_stratum_v2;
+                }
+                
                 /**
-                 * We only support stratum (for now).
+                 * We only support stratum (v1 and v2).
                  */
                 if (pos == std::string::npos)
                 {
@@ -343,6 +549,9 @@ void stack_impl::parse_command_line_args(
                     configuration::instance().work_hosts().push_back(
                         work_host
                     );
+                    configuration::instance().work_host_protocols().push_back(
+                        protocol
+                    );
                 }
             }
             
@@ -366,8 +575,34 @@ void stack_impl::parse_command_line_args(
     }
 }
 
-void stack_impl::loop()
+void stack_impl::loop(const std::uint32_t & index)
 {
+#if (defined __linux__)
+    const auto & cores = configuration::instance().io_cores();
+    
+    /**
+     * Pin this thread to it's core (round-robin).
+     */
+    if (cores.size() > 0)
+    {
+        cpu_set_t cpuset;
+        
+        CPU_ZERO(&cpuset);
+        CPU_SET(cores[index % cores.size()], &cpuset);
+        
+        if (
+            pthread_setaffinity_np(pthread_self(), sizeof(cpuset),
+            &cpuset) != 0
+            )
+        {
+            log_error(
+                "Stack failed to pin io thread " << index << " to core " <<
+                cores[index % cores.size()] << "."
+            );
+        }
+    }
+#endif // __linux__
+
     while (work_)
     {
         try
@@ -400,6 +635,14 @@ void stack_impl::handle_work(const std::shared_ptr<stratum_work> & work)
 {
     log_debug("Stack handle work.");
     
+    /**
+     * Re-issue the work to the downstream miners.
+     */
+    if (m_stratum_server)
+    {
+        m_stratum_server->set_work(work);
+    }
+    
     /**
      * Check the device type.
      */
@@ -435,6 +678,59 @@ void stack_impl::handle_work(const std::shared_ptr<stratum_work> & work)
     }
 }
 
+void stack_impl::handle_works(
+    const std::map<std::uint32_t, std::shared_ptr<stratum_work> > & works
+    )
+{
+    log_debug("Stack handle works.");
+    
+    /**
+     * Re-issue the work (of the first weighted work host) to the
+     * downstream miners.
+     */
+    if (m_stratum_server)
+    {
+        m_stratum_server->set_work(work_manager::split_work(works, 0, 1));
+    }
+    
+    /**
+     * Check the device type.
+     */
+    if (
+        configuration::instance().device_type() ==
+        configuration::device_type_cpu
+        )
+    {
+        if (m_cpu_manager)
+        {
+            m_cpu_manager->set_works(works);
+        }
+    }
+    else if (
+        configuration::instance().device_type() ==
+        configuration::device_type_gpu
+        )
+    {
+        /**
+         * The GPU's are not split (the work is shared by all of them).
+         */
+        if (m_gpu_manager)
+        {
+            m_gpu_manager->set_work(work_manager::split_work(works, 0, 1));
+        }
+    }
+    else if (
+        configuration::instance().device_type() ==
+        configuration::device_type_serial
+        )
+    {
+        if (m_serial_manager)
+        {
+            m_serial_manager->set_works(works);
+        }
+    }
+}
+
 void stack_impl::update_statistics()
 {
     log_debug("Stack update statistics.");
@@ -449,19 +745,12 @@ void stack_impl::update_statistics()
     {
         if (m_cpu_manager)
         {
-            double hashes_per_second = 0.0;
-            
-            const auto & cpus = m_cpu_manager->cpus();
-            
-            for (auto & i : cpus)
-            {
-                hashes_per_second += i->hashes_per_second();
-            }
-            
             /**
              * Set the statistics hashes_per_second.
              */
-            statistics::instance().set_hashes_per_second(hashes_per_second);
+            statistics::instance().set_hashes_per_second(
+                m_cpu_manager->hashes_per_second()
+            );
         }
     }
     else if (
@@ -512,3 +801,77 @@ void stack_impl::update_statistics()
         }
     }
 }
+
+void stack_impl::set_device_cores(const std::uint32_t & val)
+{
+    if (val == 0)
+    {
+        return;
+    }
+    
+    m_io_service.post(strand_.wrap(
+        [this, val] ()
+        {
+            log_info("Stack is setting device cores = " << val << ".");
+            
+            /**
+             * Set the device cores (this also disables automatic sizing).
+             */
+            configuration::instance().set_device_cores(val);
+            
+            if (m_cpu_manager)
+            {
+                m_cpu_manager->set_device_cores(val);
+            }
+        })
+    );
+}
+
+void stack_impl::adjust_device_cores(const std::int32_t & delta)
+{
+    /**
+     * The current number of device cores is read on the strand so
+     * consecutive adjustments are applied one after the other.
+     */
+    m_io_service.post(strand_.wrap(
+        [this, delta] ()
+        {
+            if (m_cpu_manager)
+            {
+                std::int64_t val =
+                    static_cast<std::int64_t> (m_cpu_manager->device_cores()) +
+                    delta
+                ;
+                
+                if (val < 1)
+                {
+                    val = 1;
+                }
+                
+                log_info("Stack is setting device cores = " << val << ".");
+                
+                /**
+                 * Set the device cores (this also disables automatic
+                 * sizing).
+                 */
+                configuration::instance().set_device_cores(
+                    static_cast<std::uint32_t> (val)
+                );
+                
+                m_cpu_manager->set_device_cores(
+                    static_cast<std::uint32_t> (val)
+                );
+            }
+        })
+    );
+}
+
+std::uint32_t stack_impl::device_cores()
+{
+    if (m_cpu_manager)
+    {
+        return m_cpu_manager->device_cores();
+    }
+    
+    return 0;
+}
@@ -18,12 +18,19 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <cstring>
+#include <iomanip>
+#include <sstream>
+
 #include <miner/statistics.hpp>
 
 using namespace miner;
 
 statistics::statistics()
     : m_hashes_per_second(0.0)
+    , m_watts(0.0)
+    , m_temperature(0.0)
+    , m_work_latency(0.0)
 {
     // ...
 }
@@ -44,3 +51,203 @@ const double & statistics::hashes_per_second() const
 {
     return m_hashes_per_second;
 }
+
+void statistics::set_watts(const double & val)
+{
+    m_watts = val;
+}
+
+const double & statistics::watts() const
+{
+    return m_watts;
+}
+
+void statistics::set_temperature(const double & val)
+{
+    m_temperature = val;
+}
+
+const double & statistics::temperature() const
+{
+    return m_temperature;
+}
+
+double statistics::hashes_per_joule() const
+{
+    return m_watts > 0.0 ? m_hashes_per_second / m_watts : 0.0;
+}
+
+void statistics::set_work_latency(const double & val)
+{
+    m_work_latency = val;
+}
+
+double statistics::work_latency() const
+{
+    return m_work_latency;
+}
+
+/**
+ * The submit latency histogram bucket bounds in milliseconds.
+ */
+static const double g_submit_latency_bounds[
+    statistics::submit_latency_buckets - 1] =
+{
+    10.0, 25.0, 50.0, 100.0, 250.0, 500.0, 1000.0
+};
+
+/**
+ * The job age histogram bucket bounds in seconds.
+ */
+static const double g_submit_job_age_bounds[
+    statistics::submit_job_age_buckets - 1] =
+{
+    1.0, 5.0, 15.0, 30.0, 60.0
+};
+
+void statistics::record_submit(
+    const std::string & pool,
+    const std::chrono::steady_clock::duration & latency,
+    const std::chrono::steady_clock::duration & job_age,
+    const bool & accepted, const bool & stale
+    )
+{
+    auto milliseconds =
+        std::chrono::duration<double, std::milli> (latency).count()
+    ;
+    auto seconds = std::chrono::duration<double> (job_age).count();
+    
+    auto index_latency = 0;
+    
+    while (
+        index_latency < submit_latency_buckets - 1 &&
+        milliseconds >= g_submit_latency_bounds[index_latency]
+        )
+    {
+        index_latency++;
+    }
+    
+    auto index_job_age = 0;
+    
+    while (
+        index_job_age < submit_job_age_buckets - 1 &&
+        seconds >= g_submit_job_age_bounds[index_job_age]
+        )
+    {
+        index_job_age++;
+    }
+    
+    std::lock_guard<std::mutex> l1(mutex_submits_);
+    
+    auto & s = submits(pool);
+    
+    s.latency[index_latency]++;
+    
+    if (accepted)
+    {
+        s.accepted[index_job_age]++;
+    }
+    else
+    {
+        s.rejected[index_job_age]++;
+        
+        if (stale)
+        {
+            s.rejected_stale++;
+        }
+    }
+    
+    s.latency_total += milliseconds;
+    s.count++;
+}
+
+void statistics::record_stale_drop(const std::string & pool)
+{
+    std::lock_guard<std::mutex> l1(mutex_submits_);
+    
+    submits(pool).dropped_stale++;
+}
+
+std::string statistics::submits_report()
+{
+    std::stringstream ss;
+    
+    std::lock_guard<std::mutex> l1(mutex_submits_);
+    
+    for (auto & i : m_submits)
+    {
+        ss <<
+            "\n\t" << i.first << ": " << i.second.count << " submits, " <<
+            std::fixed << std::setprecision(2) <<
+            (i.second.count > 0 ?
+            i.second.latency_total / i.second.count : 0.0) << " ms average" <<
+            "\n\t\tlatency (ms):"
+        ;
+        
+        for (auto j = 0; j < submit_latency_buckets; j++)
+        {
+            ss << " ";
+            
+            if (j < submit_latency_buckets - 1)
+            {
+                ss <<
+                    "<" << static_cast<int> (g_submit_latency_bounds[j])
+                ;
+            }
+            else
+            {
+                ss <<
+                    ">=" << static_cast<int> (g_submit_latency_bounds[j - 1])
+                ;
+            }
+            
+            ss << "=" << i.second.latency[j];
+        }
+        
+        ss << "\n\t\taccepted/rejected by job age (s):";
+        
+        for (auto j = 0; j < submit_job_age_buckets; j++)
+        {
+            ss << " ";
+            
+            if (j < submit_job_age_buckets - 1)
+            {
+                ss <<
+                    "<" << static_cast<int> (g_submit_job_age_bounds[j])
+                ;
+            }
+            else
+            {
+                ss <<
+                    ">=" << static_cast<int> (g_submit_job_age_bounds[j - 1])
+                ;
+            }
+            
+            ss << "=" << i.second.accepted[j] << "/" << i.second.rejected[j];
+        }
+        
+        ss <<
+            "\n\t\tstale: " << i.second.rejected_stale <<
+            " rejected by the pool, " << i.second.dropped_stale <<
+            " dropped before submit"
+        ;
+    }
+    
+    return ss.str();
+}
+
+statistics::submits_t & statistics::submits(const std::string & pool)
+{
+    auto it = m_submits.find(pool);
+    
+    if (it == m_submits.end())
+    {
+        submits_t submits;
+        
+        std::memset(&submits, 0, sizeof(submits));
+        
+        it = m_submits.insert(std::make_pair(pool, submits)).first;
+    }
+    
+    return it->second;
+}
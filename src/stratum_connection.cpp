@@ -18,32 +18,125 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
 #include <boost/asio.hpp>
-#include <boost/property_tree/json_parser.hpp>
 
+#include <miner/configuration.hpp>
+#include <miner/endpoint_cache.hpp>
 #include <miner/logger.hpp>
 #include <miner/sha256.hpp>
 #include <miner/stack_impl.hpp>
 #include <miner/statistics.hpp>
 #include <miner/stratum.hpp>
 #include <miner/stratum_connection.hpp>
+#include <miner/stratum_probe.hpp>
 #include <miner/stratum_work.hpp>
+#include <miner/tcp_connector.hpp>
 #include <miner/utility.hpp>
 #include <miner/work_manager.hpp>
 
 using namespace miner;
 
-stratum_connection::stratum_connection(stack_impl & owner)
+stratum_connection::stratum_connection(
+    stack_impl & owner, const std::uint32_t & work_host_index
+    )
     : m_next_difficulty(1.0f)
+    , m_state(state_none)
     , stack_impl_(owner)
     , strand_(stack_impl_.io_service())
     , timeout_timer_(stack_impl_.io_service())
+    , resolver_(stack_impl_.io_service())
+    , work_host_index_(work_host_index)
+    , port_(0)
+    , next_id_(4)
+    , shares_(0)
+    , suggest_difficulty_id_(0)
+{
+    const auto & work_host =
+        configuration::instance().work_hosts()[work_host_index_]
+    ;
+    
+    host_ = work_host.second.first;
+    port_ = work_host.second.second;
+    username_ = work_host.first.first;
+    password_ = work_host.first.second;
+}
+
+stratum_connection::~stratum_connection()
 {
     // ...
 }
 
+/**
+ * Converts a (share) difficulty to a target.
+ * @note If this were the Scrypt algorithm you would use difficulty / 65536.0
+ * @param val The difficulty.
+ * @param target The target (8 words).
+ */
+static void difficulty_to_target(const double & val, std::uint32_t * target)
+{
+	std::uint64_t m;
+
+    std::int32_t k;
+    
+    auto difficulty = val;
+    
+	for (k = 6; k > 0 && difficulty > 1.0; k--)
+    {
+		difficulty /= 4294967296.0;
+	}
+    
+    m = 4294901760.0 / difficulty;
+	
+    if (m == 0 && k == 6)
+	{
+    	std::memset(target, 0xff, 32);
+	}
+    else
+    {
+		std::memset(target, 0, 32);
+		
+        target[k] = static_cast<std::uint32_t> (m);
+		target[k + 1] = static_cast<std::uint32_t> (m >> 32);
+	}
+}
+
+/**
+ * The name of a state.
+ * @param val The state.
+ */
+static const char * state_name(const stratum_connection::state_t & val)
+{
+    switch (val)
+    {
+        case stratum_connection::state_none:
+            return "none";
+        case stratum_connection::state_resolving:
+            return "resolving";
+        case stratum_connection::state_connecting:
+            return "connecting";
+        case stratum_connection::state_subscribing:
+            return "subscribing";
+        case stratum_connection::state_authorizing:
+            return "authorizing";
+        case stratum_connection::state_notifying:
+            return "waiting for work";
+        case stratum_connection::state_mining:
+            return "mining";
+        case stratum_connection::state_stopped:
+            return "stopped";
+    }
+    
+    return "unknown";
+}
+
 void stratum_connection::start()
 {
+    pool_ = host_ + ":" + std::to_string(port_);
+    
     response_.reset(new boost::asio::streambuf());
 
     /**
@@ -51,646 +144,1267 @@ void stratum_connection::start()
      */
     socket_.reset(new boost::asio::ip::tcp::socket(stack_impl_.io_service()));
     
-    auto self(shared_from_this());
-    
-    timeout_timer_.expires_from_now(std::chrono::seconds(8));
-    timeout_timer_.async_wait(
-        strand_.wrap(
-            [this, self](boost::system::error_code ec)
-            {
-                if (ec)
-                {
-                    // ...
-                }
-                else
-                {
-                    if (socket_)
-                    {
-                        socket_->close();
-                    }
-                    
-                    log_info("Stratum connection timed out.");
-                }
-            }
-        )
+    /**
+     * Start the coroutine on the strand.
+     */
+    stack_impl_.io_service().post(strand_.wrap(
+        std::bind(
+            &stratum_connection::run, shared_from_this(),
+            boost::system::error_code(), 0
+        ))
     );
-    
-    try
-    {
-        boost::asio::ip::tcp::resolver resolver(stack_impl_.io_service());
-        boost::asio::ip::tcp::resolver::query query(
-            stratum::instance().host(),
-            std::to_string(stratum::instance().port())
-        );
-        
-        do_connect(resolver.resolve(query));
-    }
-    catch (std::exception & e)
-    {
-        log_debug(
-            "Http transport resolve failed, what = " << e.what() << "."
-        );
-
-        timeout_timer_.cancel();
-        
-        if (socket_)
-        {
-            socket_->close();
-        }
-    }
 }
 
 void stratum_connection::stop()
 {
-    timeout_timer_.cancel();
+    auto self(shared_from_this());
     
-    if (socket_)
-    {
-        socket_->close();
-    }
+    /**
+     * Stop on the strand since the handlers may be running on another
+     * io_service thread.
+     */
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self] ()
+        {
+            close();
+        })
+    );
+}
+
+void stratum_connection::set_session(
+    const std::string & session_id,
+    const std::vector<std::uint8_t> & extranonce1,
+    const std::size_t & extranonce2_size
+    )
+{
+    m_session_id = session_id;
+    m_extranonce1 = extranonce1;
+    m_extranonce1_size = m_extranonce1.size();
+    m_extranonce2_size = extranonce2_size;
 }
 
 void stratum_connection::write(const std::string & buf)
+{
+    write(std::make_shared<std::string> (buf));
+}
+
+void stratum_connection::write(
+    const std::shared_ptr<std::string> & buf, const bool & priority
+    )
 {
     auto self(shared_from_this());
 
     stack_impl_.io_service().post(strand_.wrap(
-        [this, self, buf] ()
+        [this, self, buf, priority] ()
         {
-            bool write_in_progress = write_queue_.size() > 0;
-
-            write_queue_.push_back(buf);
-          
-            if (write_in_progress == false)
+            if (priority)
+            {
+                write_queue_priority_.push_back(buf);
+            }
+            else
+            {
+                write_queue_.push_back(buf);
+            }
+            
+            /**
+             * If a write is in progress the buffer is coalesced into the
+             * next one.
+             */
+            if (writing_.size() == 0)
             {
-                do_write(write_queue_.front());
+                do_write();
             }
         })
     );
 }
 
-void stratum_connection::do_connect(
-    boost::asio::ip::tcp::resolver::iterator endpoint_iterator
+void stratum_connection::submit(
+    const std::shared_ptr<std::string> & buf, const std::size_t & id_offset,
+    const submit_t & val
     )
 {
     auto self(shared_from_this());
-    
-    log_debug(
-        "Stratum connection is connecting to " << endpoint_iterator->endpoint()
-    );
-    
-    boost::asio::async_connect(*socket_, endpoint_iterator,
-        [this, self, endpoint_iterator](boost::system::error_code ec,
-        boost::asio::ip::tcp::resolver::iterator)
+
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self, buf, id_offset, val] ()
         {
-            if (ec)
+            /**
+             * The connection was closed, the share is not written.
+             */
+            if (m_state == state_stopped)
             {
                 log_error(
-                    "Stratum connection to " <<
-                    endpoint_iterator->endpoint() << " failed, message = " <<
-                    ec.message() << "."
+                    "Stratum connection is stopped, dropping share."
                 );
                 
-                /**
-                 * Cancel the timeout timer.
-                 */
-                timeout_timer_.cancel();
+                if (val.handler)
+                {
+                    val.handler(false);
+                }
                 
-                /**
-                 * Close the socket.
-                 */
-                socket_->close();
+                return;
             }
-            else
+            
+            auto id = next_id_++;
+            
+            /**
+             * Patch the id (left aligned, the slot is whitespace padded).
+             */
+            char digits[20];
+            
+            auto len = 0;
+            
+            for (auto i = id; len == 0 || i > 0; i /= 10)
+            {
+                digits[len++] = '0' + i % 10;
+            }
+            
+            assert(len <= stratum_work::submit_id_length);
+            
+            for (auto i = 0; i < len; i++)
+            {
+                (*buf)[id_offset + i] = digits[len - 1 - i];
+            }
+            
+            auto now = std::chrono::steady_clock::now();
+            
+            /**
+             * Forget the submits the pool never answered.
+             */
+            while (
+                submits_.size() > 0 && now - submits_.begin()->second.time_sent >
+                std::chrono::seconds(120)
+                )
             {
-                log_debug("HTTP transport connected, sending request.");
+                log_error(
+                    "Stratum connection mining.submit " <<
+                    submits_.begin()->first << " timed out."
+                );
                 
-                /**
-                 * Cancel the timeout timer.
-                 */
-                timeout_timer_.cancel();
+                auto handler = submits_.begin()->second.handler;
                 
                 /**
-                 * Start reading.
+                 * A share still held is not written.
                  */
-                do_read();
+                auto it = std::find_if(
+                    submits_pending_.begin(), submits_pending_.end(),
+                    [this] (const std::pair<
+                        std::uint64_t, std::shared_ptr<std::string> > & i)
+                    {
+                        return i.first == submits_.begin()->first;
+                    }
+                );
                 
-                const auto & username = stratum::instance().username();
-                const auto & password = stratum::instance().password();
+                if (it != submits_pending_.end())
+                {
+                    submits_pending_.erase(it);
+                }
                 
-                /**
-                 * Write the request.
-                 */
-                write(
-                    "{\"id\": 1, \"method\": \"mining.subscribe\", \"params\": "
-                    "[]}\n"
-                    "{\"params\": [\"" + username + "\", \"" + password + "\"]"
-                    ", \"id\": 2, \"method\": \"mining.authorize\"}\n"
-                );
+                submits_.erase(submits_.begin());
+                
+                if (handler)
+                {
+                    handler(false);
+                }
             }
-        }
-    );
-}
-
-void stratum_connection::do_read()
-{
-    auto self(shared_from_this());
-    
-    boost::asio::async_read_until(*socket_, *response_.get(), "\n",
-        [this, self](boost::system::error_code ec, std::size_t)
-        {
-            if (ec)
+            
+            submits_[id] = val;
+            submits_[id].time_sent = now;
+            
+            shares_++;
+            
+            /**
+             * Hold the share until the (resumed) session is authorized.
+             */
+            if (m_state < state_notifying)
             {
-                log_error("Stratum connection read failed.");
+                submits_pending_.push_back(std::make_pair(id, buf));
                 
-                /**
-                 * Close the socket.
-                 */
-                socket_->close();
+                return;
             }
-            else
+            
+            write_queue_priority_.push_back(buf);
+            
+            if (writing_.size() == 0)
             {
-                std::istream response_istream(response_.get());
-
-                std::string json_line;
-                
-                std::getline(response_istream, json_line);
-
-                try
-                {
-                    /**
-                     * Handles the JSON line.
-                     */
-                    handle_json_line(json_line);
-                }
-                catch (std::exception & e)
-                {
-                    log_error(
-                        "Stratum connection handle JSON line failed, "
-                        "what = " << e.what() << ""
-                    );
-                }
-
-                /**
-                 * Continue reading.
-                 */
-                do_read();
+                do_write();
             }
-        }
+        })
     );
 }
 
-void stratum_connection::do_write(const std::string & buf)
+void stratum_connection::submit_header(
+    const share_queue::share_t &, const std::shared_ptr<stratum_work> &,
+    const submit_t & val
+    )
 {
-    auto self(shared_from_this());
+    log_error(
+        "Stratum connection does not support header-only jobs, dropping "
+        "share."
+    );
+    
+    if (val.handler)
+    {
+        val.handler(false);
+    }
+}
 
-    boost::asio::async_write(*socket_, boost::asio::buffer(buf),
-        [this, self](boost::system::error_code ec, std::size_t)
+void stratum_connection::suggest_difficulty()
+{
+    auto self(shared_from_this());
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self] ()
         {
-            if (ec)
+            auto share_rate = configuration::instance().share_rate();
+            
+            if (share_rate <= 0.0 || m_state != state_mining)
             {
-                log_error("Stratum connection write failed.");
+                return;
             }
-            else
+            
+            auto now = std::chrono::steady_clock::now();
+            
+            if (time_shares_ == std::chrono::steady_clock::time_point())
             {
-                if (write_queue_.size() > 0)
-                {
-                    write_queue_.pop_front();
-                }
+                time_shares_ = now;
                 
-                if (write_queue_.size() == 0)
-                {
-                    // ...
-                }
-                else
-                {
-                    do_write(write_queue_.front());
-                }
+                return;
             }
-        }
+            
+            auto elapsed = std::chrono::duration_cast<
+                std::chrono::milliseconds> (now - time_shares_).count() /
+                1000.0
+            ;
+            
+            /**
+             * Measure over a minute (or longer if no share was found).
+             */
+            if (elapsed < 60.0)
+            {
+                return;
+            }
+            
+            auto rate = shares_ * 60.0 / elapsed;
+            
+            /**
+             * Scale the difficulty by the measured rate over the target
+             * rate (at most 4x per step, halving if no share was found).
+             */
+            auto ratio = shares_ > 0 ? rate / share_rate : 0.5;
+            
+            ratio = (std::max)(0.25, (std::min)(ratio, 4.0));
+            
+            shares_ = 0;
+            time_shares_ = now;
+            
+            /**
+             * Ignore changes within the noise of the measurement.
+             */
+            if (ratio > 0.8 && ratio < 1.25)
+            {
+                return;
+            }
+            
+            auto difficulty = m_next_difficulty * ratio;
+            
+            suggest_difficulty_id_ = next_id_++;
+            
+            log_info(
+                "Stratum connection share rate is " << rate <<
+                "/min, suggesting difficulty " << difficulty << "."
+            );
+            
+            std::stringstream ss;
+            
+            ss <<
+                "{\"id\": " << suggest_difficulty_id_ << ", \"method\": "
+                "\"mining.suggest_difficulty\", \"params\": [" <<
+                difficulty << "]}\n"
+            ;
+            
+            write_queue_.push_back(std::make_shared<std::string> (ss.str()));
+            
+            if (writing_.size() == 0)
+            {
+                do_write();
+            }
+        })
     );
 }
 
-void stratum_connection::handle_json_line(const std::string & json_line)
+const stratum_connection::state_t & stratum_connection::state() const
 {
-    std::stringstream ss;
+    return m_state;
+}
 
-    ss << json_line;
+const std::uint32_t & stratum_connection::work_host_index() const
+{
+    return work_host_index_;
+}
 
-    boost::property_tree::ptree pt;
+#include <boost/asio/yield.hpp>
 
-    try
+void stratum_connection::run(
+    const boost::system::error_code & ec, std::size_t len
+    )
+{
+    if (m_state == state_stopped)
     {
-        read_json(ss, pt);
-
-        std::string method;
+        return;
+    }
+    else if (ec)
+    {
+        log_error(
+            "Stratum connection failed while " << state_name(m_state) <<
+            ", message = " << ec.message() << "."
+        );
         
-        try
-        {
-            method = pt.get_child("method").get<std::string> ("");
-        }
-        catch (...)
-        {
-            // ...
-        }
+        /**
+         * Close the socket.
+         */
+        close();
         
-        boost::property_tree::ptree params;
+        return;
+    }
+    
+    auto self(shared_from_this());
+    
+    reenter (coroutine_)
+    {
+        set_state(state_resolving);
         
-        try
-        {
-            params = pt.get_child("params");
-        }
-        catch (...)
+        /**
+         * Resolve unless the endpoints are cached.
+         */
+        if (endpoint_cache::instance().find(host_, port_, endpoints_) == false)
         {
-            // ...
+            yield resolver_.async_resolve(
+                boost::asio::ip::tcp::resolver::query(
+                host_, std::to_string(port_)), strand_.wrap(
+                [this, self](boost::system::error_code ec,
+                boost::asio::ip::tcp::resolver::iterator it)
+                {
+                    if (ec)
+                    {
+                        // ...
+                    }
+                    else
+                    {
+                        endpoints_.assign(
+                            it, boost::asio::ip::tcp::resolver::iterator()
+                        );
+                        
+                        endpoint_cache::instance().insert(
+                            host_, port_, endpoints_
+                        );
+                    }
+                    
+                    run(ec, 0);
+                })
+            );
         }
         
-        boost::property_tree::ptree result;
+        set_state(state_connecting);
         
-        try
-        {
-            result = pt.get_child("result");
-        }
-        catch (...)
-        {
-            // ...
-        }
+        log_debug(
+            "Stratum connection is connecting to " << pool_ << " (" <<
+            endpoints_.size() << " endpoints)."
+        );
         
-        boost::property_tree::ptree error;
+        /**
+         * Race the endpoints keeping the first socket that connects.
+         */
+        connector_ = std::make_shared<tcp_connector> (
+            stack_impl_.io_service(), strand_
+        );
         
-        try
-        {
-            error = pt.get_child("error");
-        }
-        catch (...)
-        {
-            // ...
-        }
-
-        auto id = pt.get_child("id").get<std::string> ("");
-
-        if (method.size() > 0)
+        time_connect_ = std::chrono::steady_clock::now();
+        
+        yield connector_->start(endpoints_,
+            [this, self](const boost::system::error_code & ec,
+            const std::shared_ptr<boost::asio::ip::tcp::socket> & socket)
+            {
+                if (ec)
+                {
+                    /**
+                     * None of the endpoints connected, resolve again next
+                     * time.
+                     */
+                    endpoint_cache::instance().erase(host_, port_);
+                }
+                else
+                {
+                    socket_ = socket;
+                }
+                
+                run(ec, 0);
+            }
+        );
+        
+        log_debug("Stratum connection connected, subscribing.");
+        
+        /**
+         * Disable Nagle's algorithm so a share is sent immediately.
+         */
         {
-            log_debug(
-                "Stratum connection got method = " << method <<
-                ", params = " << params.size() << ", id = " << id << "."
-            );
+            boost::system::error_code ec_no_delay;
             
-            /**
-             * Handle the JSON-RPC error.
-             */
-            handle_json_rpc_method(id, method, params);
+            socket_->set_option(
+                boost::asio::ip::tcp::no_delay(true), ec_no_delay
+            );
         }
-        else if (result.size() > 0)
+        
+        set_state(state_subscribing);
+        
+        time_subscribe_ = std::chrono::steady_clock::now();
+        
+        /**
+         * Write the mining.subscribe (offering the previous session for
+         * resumption), mining.authorize and mining.extranonce.subscribe
+         * pipelined, the state advances as each result arrives.
+         */
+        write(
+            "{\"id\": 1, \"method\": \"mining.subscribe\", \"params\": " +
+            std::string(m_session_id.size() > 0 ?
+            "[\"minerpp\", \"" + m_session_id + "\"]" : "[]") + "}\n"
+            "{\"params\": [\"" + username_ + "\", \"" + password_ + "\"]"
+            ", \"id\": 2, \"method\": \"mining.authorize\"}\n"
+            "{\"id\": 3, \"method\": \"mining.extranonce.subscribe\", "
+            "\"params\": []}\n"
+        );
+        
+        for (;;)
         {
-            log_debug(
-                "Stratum connection got result = " <<
-                result.size() << ", id = " << id << "."
+            yield boost::asio::async_read_until(
+                *socket_, *response_.get(), "\n", strand_.wrap(
+                make_allocator_handler(handler_allocator_read_, std::bind(
+                &stratum_connection::run, self, std::placeholders::_1,
+                std::placeholders::_2)))
             );
             
-            /**
-             * Handle the JSON-RPC result.
-             */
-            handle_json_rpc_result(id, result);
+            {
+                /**
+                 * The line (including the delimiter) is at the beginning of
+                 * the (contiguous) input sequence, parse it in place.
+                 */
+                auto buf = boost::asio::buffer_cast<const char *> (
+                    response_->data()
+                );
+                
+                try
+                {
+                    /**
+                     * Handles the JSON line.
+                     */
+                    handle_json_line(buf, len);
+                }
+                catch (std::exception & e)
+                {
+                    log_error(
+                        "Stratum connection handle JSON line failed, "
+                        "what = " << e.what() << ""
+                    );
+                }
+                
+                response_->consume(len);
+            }
         }
-        else if (error.size() > 0)
+    }
+}
+
+#include <boost/asio/unyield.hpp>
+
+void stratum_connection::set_state(const state_t & val)
+{
+    m_state = val;
+    
+    /**
+     * The deadline of the state in seconds (zero is none).
+     */
+    auto timeout = 0;
+    
+    switch (m_state)
+    {
+        case state_resolving:
+        case state_connecting:
         {
-            log_debug(
-                "Stratum connection got error = " << error.size() <<
-                ", id = " << id << "."
-            );
-            
-            /**
-             * Handle the JSON-RPC error.
-             */
-            handle_json_rpc_error(id, error);
+            timeout = 4;
         }
-        else if (params.size() > 0)
+        break;
+        case state_subscribing:
+        case state_authorizing:
         {
-            assert(0);
+            timeout = 8;
         }
-        else
+        break;
+        case state_notifying:
         {
-            /**
-             * Check for the mining.authorize or mining.submit id.
-             */
-            if (id == "2")
+            timeout = 16;
+        }
+        break;
+        default:
+        break;
+    }
+    
+    if (timeout > 0)
+    {
+        auto self(shared_from_this());
+        
+        /**
+         * Setting the expiry cancels the deadline of the previous state.
+         */
+        timeout_timer_.expires_from_now(std::chrono::seconds(timeout));
+        timeout_timer_.async_wait(strand_.wrap(
+            [this, self](boost::system::error_code ec)
             {
-                /**
-                 * Most likely a result code.
-                 */
-                if (result.empty() && result.data().empty() == false)
+                if (ec)
                 {
-                    if (result.get<bool> (""))
-                    {
-                        log_info("Stratum connection authorization success.");
-                    }
-                    else
+                    // ...
+                }
+                else
+                {
+                    log_info(
+                        "Stratum connection timed out while " <<
+                        state_name(m_state) << "."
+                    );
+                    
+                    /**
+                     * The cached endpoints may be dead, resolve them again
+                     * on the next connect.
+                     */
+                    if (m_state < state_authorizing)
                     {
-                        log_error("Stratum connection authorization failure.");
+                        endpoint_cache::instance().erase(host_, port_);
                     }
+                    
+                    /**
+                     * Close the socket.
+                     */
+                    close();
                 }
+            })
+        );
+    }
+    else
+    {
+        timeout_timer_.cancel();
+    }
+}
+
+void stratum_connection::close()
+{
+    if (m_state == state_stopped)
+    {
+        return;
+    }
+    
+    m_state = state_stopped;
+    
+    timeout_timer_.cancel();
+    
+    resolver_.cancel();
+    
+    if (connector_)
+    {
+        connector_->cancel();
+    }
+    
+    if (socket_)
+    {
+        boost::system::error_code ec;
+        
+        socket_->close(ec);
+    }
+    
+    /**
+     * Inform the work manager so it can switch to a backup immediately.
+     */
+    stack_impl_.get_work_manager()->handle_disconnect(work_host_index_);
+}
+
+void stratum_connection::do_write()
+{
+    /**
+     * Gather the priority queue followed by the queue.
+     */
+    for (auto & i : write_queue_priority_)
+    {
+        writing_.push_back(i);
+    }
+    
+    for (auto & i : write_queue_)
+    {
+        writing_.push_back(i);
+    }
+    
+    write_queue_priority_.clear();
+    write_queue_.clear();
+    
+    if (writing_.size() == 0)
+    {
+        return;
+    }
+    
+    write_buffers_.clear();
+    
+    for (auto & i : writing_)
+    {
+        write_buffers_.push_back(boost::asio::buffer(*i));
+    }
+    
+    auto self(shared_from_this());
+
+    /**
+     * The buffers are retained until the write completes.
+     */
+    boost::asio::async_write(*socket_, write_buffers_,
+        strand_.wrap(make_allocator_handler(handler_allocator_write_,
+        [this, self](boost::system::error_code ec, std::size_t)
+        {
+            writing_.clear();
+            
+            if (ec)
+            {
+                log_error("Stratum connection write failed.");
             }
-            else if (id == "4")
+            else
             {
-                log_debug("Stratum connection mining.submit result (true).");
-                
-                handle_mining_submit_result(true);
+                /**
+                 * Write anything queued during the write.
+                 */
+                do_write();
             }
+        }))
+    );
+}
+
+void stratum_connection::handle_json_line(
+    const char * buf, const std::size_t & len
+    )
+{
+    auto time_start = std::chrono::steady_clock::now();
+    
+    if (parser_.parse(buf, len) == false)
+    {
+        log_error(
+            "Stratum connection failed to parse JSON-RPC line = " <<
+            std::string(buf, len) << "."
+        );
+        
+        return;
+    }
+
+    auto method = parser_.find(0, "method");
+    auto params = parser_.find(0, "params");
+    auto result = parser_.find(0, "result");
+    auto error = parser_.find(0, "error");
+    
+    /**
+     * The id (zero if null).
+     */
+    auto id = parser_.to_uint64(parser_.find(0, "id"));
+
+    if (parser_.is_null(method) == false)
+    {
+        log_debug(
+            "Stratum connection got method = " << parser_.to_string(method) <<
+            ", params = " << parser_.count(params) << ", id = " << id << "."
+        );
+        
+        auto is_mining_notify = parser_.equals(method, "mining.notify");
+        
+        /**
+         * Handle the JSON-RPC method.
+         */
+        handle_json_rpc_method(id, method, params);
+        
+        if (is_mining_notify)
+        {
+            log_debug(
+                "Stratum connection handled mining.notify, bytes = " << len <<
+                ", microseconds = " <<
+                std::chrono::duration_cast<std::chrono::microseconds> (
+                std::chrono::steady_clock::now() - time_start).count() << "."
+            );
         }
     }
-    catch (std::exception & e)
+    else if (parser_.is_null(error) == false)
     {
-        log_error(
-            "Stratum connection failed to parse JSON-RPC line, what = " <<
-            e.what() << "."
+        log_debug(
+            "Stratum connection got error = " << parser_.count(error) <<
+            ", id = " << id << "."
         );
+        
+        /**
+         * Handle the JSON-RPC error.
+         */
+        handle_json_rpc_error(id, error);
+    }
+    else if (parser_.is_null(result) == false)
+    {
+        log_debug(
+            "Stratum connection got result = " << parser_.count(result) <<
+            ", id = " << id << "."
+        );
+        
+        /**
+         * Handle the JSON-RPC result.
+         */
+        handle_json_rpc_result(id, result);
     }
 }
 
 void stratum_connection::handle_json_rpc_method(
-    const std::string & id, const std::string & method,
-    const boost::property_tree::ptree & params
+    const std::uint64_t & id, const int & method, const int & params
     )
 {
-    try
+    if (parser_.equals(method, "mining.notify"))
     {
-        if (method == "mining.notify")
-        {
-            log_info("Stratum connection got mining.notify.");
-            
-            /**
-             * Handle the mining.notify.
-             */
-            handle_mining_notify(params);
-        }
-        else if (method == "mining.set_difficulty")
+        log_info("Stratum connection got mining.notify.");
+        
+        /**
+         * Handle the mining.notify.
+         */
+        handle_mining_notify(params);
+    }
+    else if (parser_.equals(method, "mining.set_difficulty"))
+    {
+        log_info("Stratum connection got mining.set_difficulty.");
+        
+        if (parser_.count(params) == 1)
         {
-            log_info("Stratum connection got mining.set_difficulty.");
-            
-            if (params.size() == 1)
-            {
-                auto diff = params.front().second.get<double> ("");
+            auto diff = parser_.to_double(parser_.at(params, 0));
 
-                if (diff > 0.0f)
+            if (diff > 0.0f)
+            {
+                log_info(
+                    "Stratum connection is setting difficulty to " << diff <<
+                    "."
+                );
+                
+                /**
+                 * Set the next difficulty.
+                 */
+                m_next_difficulty = diff;
+                
+                /**
+                 * The share rate is measured at the new difficulty.
+                 */
+                shares_ = 0;
+                time_shares_ = std::chrono::steady_clock::now();
+                
+                /**
+                 * Apply the target to the current job in place, the hashing
+                 * threads pick it up without a restart.
+                 */
+                if (work_)
                 {
-                    log_info(
-                        "Stratum connection is setting (next) "
-                        "difficulty to " << diff << "."
-                    );
+                    std::uint32_t target[8];
                     
-                    /**
-                     * Set the next difficulty.
-                     */
-                    m_next_difficulty = diff;
+                    difficulty_to_target(m_next_difficulty, target);
+                    
+                    work_->set_target(target, m_next_difficulty);
                 }
             }
         }
     }
-    catch (std::exception & e)
+    else if (parser_.equals(method, "mining.set_extranonce"))
+    {
+        log_info("Stratum connection got mining.set_extranonce.");
+        
+        /**
+         * Handle the mining.set_extranonce.
+         */
+        handle_mining_set_extranonce(params);
+    }
+}
+
+void stratum_connection::handle_mining_set_extranonce(const int & params)
+{
+    std::vector<std::uint8_t> extranonce1;
+    
+    if (
+        parser_.count(params) < 2 ||
+        parser_.to_bytes(parser_.at(params, 0), extranonce1) == false
+        )
+    {
+        log_error("Stratum connection got invalid mining.set_extranonce.");
+        
+        return;
+    }
+    
+    auto extranonce2_size = parser_.to_uint64(parser_.at(params, 1));
+    
+    /**
+     * The shares can not hold a larger extranonce2.
+     */
+    if (
+        extranonce2_size == 0 ||
+        extranonce2_size > share_queue::max_extranonce2_size
+        )
     {
         log_error(
-            "Stratum connection failed to handle JSON RPC method = " <<
-            method << ", what = " << e.what() << "."
+            "Stratum connection got unsupported extranonce2 size = " <<
+            extranonce2_size << " (maximum is " <<
+            share_queue::max_extranonce2_size << "), ignoring "
+            "mining.set_extranonce."
         );
+        
+        return;
     }
+    
+    /**
+     * The extranonce applies to the next job, the work already handed out
+     * (and it's shares) keeps the previous one.
+     */
+    m_extranonce1 = extranonce1;
+    m_extranonce1_size = m_extranonce1.size();
+    m_extranonce2_size = extranonce2_size;
+    m_extranonce2.assign(m_extranonce2_size, 0);
+    
+    log_info(
+        "Stratum connection is setting (next) extranonce1 to " <<
+        utility::to_hex(m_extranonce1) << ", extranonce2 size = " <<
+        m_extranonce2_size << "."
+    );
+    
+    /**
+     * Keep the session (with the new extranonce) to offer if we reconnect.
+     */
+    stack_impl_.get_work_manager()->set_session(
+        work_host_index_, m_session_id, m_extranonce1, m_extranonce2_size
+    );
 }
 
 void stratum_connection::handle_json_rpc_result(
-    const std::string & id, const boost::property_tree::ptree & result
+    const std::uint64_t & id, const int & result
     )
 {
-    if (id == "1")
+    if (id == 1)
     {
-        auto index = 0;
+        /**
+         * The session offered for resumption.
+         */
+        auto session_offered = m_session_id.size() > 0;
+        auto previous_extranonce1 = m_extranonce1;
+        auto previous_extranonce2_size = m_extranonce2_size;
+        
+        auto subscriptions_details = parser_.at(result, 0);
+        
+        /**
+         * The subscription details are either a list of
+         * [method, subscription id] pairs or a single pair.
+         */
+        auto mining_set_difficulty = parser_.at(subscriptions_details, 0);
+        
+        if (parser_.is_array(mining_set_difficulty) == false)
+        {
+            mining_set_difficulty = subscriptions_details;
+        }
+        
+        /**
+         * Set the session id.
+         */
+        m_session_id = parser_.to_string(
+            parser_.at(mining_set_difficulty, 1)
+        );
+
+        /**
+         * Set the extranonce1.
+         */
+        if (parser_.to_bytes(parser_.at(result, 1), m_extranonce1) == false)
+        {
+            log_error("Stratum connection got invalid extranonce1.");
+            
+            /**
+             * Close the socket.
+             */
+            close();
+            
+            return;
+        }
+
+        /**
+         * Set the extranonce1 size.
+         */
+        m_extranonce1_size = m_extranonce1.size();
+
+        /**
+         * The extranonce2 size.
+         */
+        m_extranonce2_size = parser_.to_uint64(parser_.at(result, 2));
         
-        boost::property_tree::ptree ptree_subscriptions_details;
-        boost::property_tree::ptree ptree_extranonce1;
-        boost::property_tree::ptree ptree_extranonce2_size;
+        /**
+         * The shares can not hold a larger extranonce2.
+         */
+        if (m_extranonce2_size > share_queue::max_extranonce2_size)
+        {
+            log_error(
+                "Stratum connection got unsupported extranonce2 size = " <<
+                m_extranonce2_size << " (maximum is " <<
+                share_queue::max_extranonce2_size << "), closing."
+            );
+            
+            close();
+            
+            return;
+        }
         
-        for (auto & i : result)
+        /**
+         * Allocate the extranonce2.
+         */
+        m_extranonce2.resize(m_extranonce2_size, 0);
+        
+        /**
+         * The session is resumed if the extranonce is unchanged so the
+         * jobs (and the shares held) of the previous one stay valid.
+         */
+        auto resumed =
+            session_offered && m_extranonce1 == previous_extranonce1 &&
+            m_extranonce2_size == previous_extranonce2_size
+        ;
+        
+        if (resumed)
+        {
+            log_info(
+                "Stratum connection resumed session " << m_session_id << "."
+            );
+        }
+        else
         {
-            if (index == 0)
+            if (session_offered)
             {
-                ptree_subscriptions_details = i.second;
+                log_info(
+                    "Stratum connection session was not resumed, "
+                    "restarting work."
+                );
+                
+                /**
+                 * Inform the work manager of null work.
+                 */
+                stack_impl_.get_work_manager()->set_work(
+                    work_host_index_, 0
+                );
             }
-            else if (index == 1)
+            
+            /**
+             * The shares held are for the previous extranonce1.
+             */
+            for (auto & i : submits_pending_)
             {
-                ptree_extranonce1 = i.second;
+                auto it = submits_.find(i.first);
+                
+                if (it != submits_.end())
+                {
+                    auto handler = it->second.handler;
+                    
+                    submits_.erase(it);
+                    
+                    if (handler)
+                    {
+                        handler(false);
+                    }
+                }
             }
-            else if (index == 2)
+            
+            if (submits_pending_.size() > 0)
             {
-                ptree_extranonce2_size = i.second;
+                log_info(
+                    "Stratum connection dropped " << submits_pending_.size() <<
+                    " shares of the previous session."
+                );
             }
             
-            index++;
+            submits_pending_.clear();
         }
         
-        boost::property_tree::ptree ptree_mining_set_difficulty;
-        boost::property_tree::ptree ptree_mining_notify;
-
-        auto index1 = 0;
+        /**
+         * Keep the session to offer if we reconnect.
+         */
+        stack_impl_.get_work_manager()->set_session(
+            work_host_index_, m_session_id, m_extranonce1, m_extranonce2_size
+        );
         
-        for (auto & i : ptree_subscriptions_details)
+        if (m_state == state_subscribing)
         {
-            auto index2 = 0;
+            set_state(state_authorizing);
+        }
+        
+        /**
+         * Report the round trip times of the handshake.
+         */
+        stratum_probe::result_t latency;
+        
+        latency.success = true;
+        latency.rtt_connect =
+            std::chrono::duration_cast<std::chrono::microseconds> (
+            time_subscribe_ - time_connect_)
+        ;
+        latency.rtt_subscribe =
+            std::chrono::duration_cast<std::chrono::microseconds> (
+            std::chrono::steady_clock::now() - time_subscribe_)
+        ;
+        latency.time = std::chrono::steady_clock::now();
+        
+        stack_impl_.get_work_manager()->handle_latency(
+            work_host_index_, latency
+        );
+    }
+    else if (id == 2)
+    {
+        if (parser_.to_bool(result))
+        {
+            log_info("Stratum connection authorization success.");
             
-            for (auto & j : i.second)
+            if (m_state == state_authorizing)
+            {
+                set_state(state_notifying);
+            }
+            
+            /**
+             * Write the shares held (of the resumed session).
+             */
+            if (submits_pending_.size() > 0)
             {
-                if (index1 == 0 && index2 == 1)
+                log_info(
+                    "Stratum connection submitting " <<
+                    submits_pending_.size() << " held shares."
+                );
+                
+                for (auto & i : submits_pending_)
                 {
-                    ptree_mining_set_difficulty = j.second;
+                    write_queue_priority_.push_back(i.second);
                 }
-                else if (index1 == 1 && index2 == 1)
+                
+                submits_pending_.clear();
+                
+                if (writing_.size() == 0)
                 {
-                    ptree_mining_notify = j.second;
+                    do_write();
                 }
-                
-                index2++;
             }
+        }
+        else
+        {
+            log_error("Stratum connection authorization failure.");
             
-            index1++;
+            /**
+             * Close the socket.
+             */
+            close();
         }
-        
-        /**
-         * Set the session id.
-         */
-        m_session_id =
-            ptree_mining_set_difficulty.get<std::string> ("")
-        ;
-        
-        /**
-         * :TODO:
-         */
-        auto mining_notify = ptree_mining_notify.get<std::string> ("");
-        
-        /**
-         * Get the extranonce1.
-         */
-        auto extranonce1 = ptree_extranonce1.get<std::string> ("");
-
-        /**
-         * Set the extranonce1.
-         */
-        m_extranonce1 = utility::from_hex(extranonce1);
-
-        /**
-         * Set the extranonce1 size.
-         */
-        m_extranonce1_size = m_extranonce1.size();
-
-        /**
-         * The extranonce2 size.
-         */
-        m_extranonce2_size = ptree_extranonce2_size.get<std::size_t> ("");
-        
-        /**
-         * Allocate the extranonce2.
-         */
-        m_extranonce2.resize(m_extranonce2_size, 0);
+    }
+    else if (id == 3)
+    {
+        log_debug(
+            "Stratum connection mining.extranonce.subscribe result = " <<
+            parser_.to_bool(result) << "."
+        );
     }
     else
     {
-        log_error("Stratum connection failed, invalid initial id.");
+        auto it = submits_.find(id);
+        
+        if (it != submits_.end())
+        {
+            auto submit = it->second;
+            
+            submits_.erase(it);
+            
+            auto accepted = parser_.to_bool(result);
+            
+            log_debug(
+                "Stratum connection mining.submit " << id << " result (" <<
+                (accepted ? "true" : "false") << ")."
+            );
+            
+            handle_mining_submit_result(accepted, submit);
+        }
+        else
+        {
+            log_debug("Stratum connection got result for unknown id " << id);
+        }
     }
 }
 
 void stratum_connection::handle_json_rpc_error(
-    const std::string & id, const boost::property_tree::ptree & error
+    const std::uint64_t & id, const int & error
     )
 {
-    try
+    /**
+     * The error code.
+     */
+    auto error_code = static_cast<std::int32_t> (
+        parser_.to_double(parser_.at(error, 0))
+    );
+    
+    /**
+     * The error message.
+     */
+    auto error_message = parser_.to_string(parser_.at(error, 1));
+    
+    if (id == 1 || id == 2)
     {
+        log_error(
+            "Stratum connection " << state_name(m_state) <<
+            " failed, code = " << error_code << ", message = " <<
+            error_message << "."
+        );
+        
         /**
-         * The error code.
+         * Close the socket.
          */
-        std::int32_t error_code = 0;
-        
+        close();
+    }
+    else if (suggest_difficulty_id_ > 0 && id == suggest_difficulty_id_)
+    {
+        log_debug(
+            "Stratum connection mining.suggest_difficulty failed, code = " <<
+            error_code << ", message = " << error_message << "."
+        );
+    }
+    else if (id == 3)
+    {
         /**
-         * The error message.
+         * The pool does not support mining.set_extranonce (it will
+         * reconnect us instead).
          */
-        std::string error_message;
-        
-        auto index = 0;
+        log_debug(
+            "Stratum connection mining.extranonce.subscribe failed, code = " <<
+            error_code << ", message = " << error_message << "."
+        );
+    }
+    else
+    {
+        auto it = submits_.find(id);
         
-        for (auto & i : error)
+        if (it != submits_.end())
         {
-            if (index == 0)
-            {
-                error_code = i.second.get<std::int32_t> ("");
-            }
-            else if (index == 1)
-            {
-                error_message = i.second.get<std::string> ("");
-            }
+            auto submit = it->second;
+            
+            submits_.erase(it);
             
-            index++;
-        }
-        
-        if (id == "4")
-        {
             log_debug(
-                "Stratum connection mining.submit result (false), "
-                "message = " << error_message << "."
+                "Stratum connection mining.submit " << id << " result "
+                "(false), job handle = " << submit.job_handle <<
+                ", nonce = " << submit.nonce << ", code = " << error_code <<
+                ", message = " << error_message << "."
+            );
+            
+            /**
+             * The share is stale if the job was not found (code 21) or the
+             * message says so.
+             */
+            auto message = error_message;
+            
+            std::transform(
+                message.begin(), message.end(), message.begin(), ::tolower
             );
             
-            handle_mining_submit_result(false);
+            auto stale =
+                error_code == 21 || message.find("stale") != std::string::npos
+            ;
+            
+            handle_mining_submit_result(false, submit, stale);
+        }
+        else
+        {
+            log_error(
+                "Stratum connection got error for id " << id <<
+                ", code = " << error_code << ", message = " <<
+                error_message << "."
+            );
         }
-    }
-    catch (std::exception & e)
-    {
-        log_error(
-            "Stratum connection " << this << " handle JSON RPC failed, "
-            "what = " << e.what() << "."
-        );
     }
 }
 
-void stratum_connection::handle_mining_notify(
-    const boost::property_tree::ptree & params
-    )
+void stratum_connection::handle_mining_notify(const int & params)
 {
-    auto index = 0;
+    /**
+     * The time the work was notified.
+     */
+    auto time_notified = std::chrono::steady_clock::now();
+    
+    /**
+     * The first mining.notify ends the deadlines.
+     */
+    if (m_state != state_mining && m_state != state_stopped)
+    {
+        set_state(state_mining);
+    }
+    
+    if (parser_.count(params) < 9)
+    {
+        log_error("Stratum connection got invalid mining.notify.");
+        
+        return;
+    }
     
     std::string job_id;
-    std::string previous_hash;
-    std::string coinb1;
-    std::string coinb2;
-    std::vector<std::string> merkles;
-    std::string version;
-    std::string bits;
-    std::string time;
+    std::vector<std::uint8_t> previous_hash;
+    std::vector<std::uint8_t> coinb1;
+    std::vector<std::uint8_t> coinb2;
+    std::vector< std::vector<std::uint8_t> > merkles;
+    std::vector<std::uint8_t> version;
+    std::vector<std::uint8_t> bits;
+    std::vector<std::uint8_t> time;
+    
+    /**
+     * The params are decoded from hexidecimal in place, in order.
+     */
+    auto i = params + 1;
+    
+    job_id = parser_.to_string(i);
+    
+    i = parser_.next(i);
+    
+    auto valid = parser_.to_bytes(i, previous_hash);
+    
+    i = parser_.next(i);
     
-    bool clean_jobs = false;
+    valid = valid && parser_.to_bytes(i, coinb1);
     
-    for (auto & i : params)
+    i = parser_.next(i);
+    
+    valid = valid && parser_.to_bytes(i, coinb2);
+    
+    i = parser_.next(i);
+    
+    /**
+     * Parse the merkle.
+     */
+    merkles.resize(parser_.count(i));
+    
+    for (std::size_t j = 0; j < merkles.size(); j++)
     {
-        switch (index)
-        {
-            case 0:
-            {
-                job_id = i.second.get<std::string> ("");
-            }
-            break;
-            case 1:
-            {
-                previous_hash = i.second.get<std::string> ("");
-            }
-            break;
-            case 2:
-            {
-                coinb1 = i.second.get<std::string> ("");
-            }
-            break;
-            case 3:
-            {
-                coinb2 = i.second.get<std::string> ("");
-            }
-            break;
-            case 4:
-            {
-                /**
-                 * Parse the merkle.
-                 */
-                if (i.second.size() > 0)
-                {
-                    for (auto & j : i.second)
-                    {
-                        auto merkle = j.second.get<std::string> ("");
-                        
-                        merkles.push_back(merkle);
-                    }
-                }
-            }
-            break;
-            case 5:
-            {
-                version = i.second.get<std::string> ("");
-            }
-            break;
-            case 6:
-            {
-                bits = i.second.get<std::string> ("");
-            }
-            break;
-            case 7:
-            {
-                time = i.second.get<std::string> ("");
-            }
-            break;
-            case 8:
-            {
-                clean_jobs = i.second.get<bool> ("");
-            }
-            break;
-            default:
-            {
-                assert(0);
-            }
-            break;
-        }
+        valid = valid && parser_.to_bytes(parser_.at(i, j), merkles[j]);
+    }
+    
+    i = parser_.next(i);
+    
+    valid = valid && parser_.to_bytes(i, version);
+    
+    i = parser_.next(i);
+    
+    valid = valid && parser_.to_bytes(i, bits);
+    
+    i = parser_.next(i);
+    
+    valid = valid && parser_.to_bytes(i, time);
+    
+    i = parser_.next(i);
+    
+    auto clean_jobs = parser_.to_bool(i);
+    
+    if (valid == false)
+    {
+        log_error(
+            "Stratum connection got invalid mining.notify, job id = " <<
+            job_id << "."
+        );
         
-        index++;
+        return;
     }
     
     if (clean_jobs)
@@ -700,7 +1414,7 @@ void stratum_connection::handle_mining_notify(
         /**
          * Inform the work manager of null work.
          */
-        stack_impl_.get_work_manager()->set_work(0);
+        stack_impl_.get_work_manager()->set_work(work_host_index_, 0);
     }
     
     /**
@@ -712,106 +1426,71 @@ void stratum_connection::handle_mining_notify(
     
     if (work)
     {
+        work->set_time_notified(time_notified);
+        
         log_debug(
             "Stratum connection generated work, difficulty = " <<
             m_next_difficulty << "."
         );
         
+        work_ = work;
+        
         /**
          * Inform the work manager of the new work.
          */
-        stack_impl_.get_work_manager()->set_work(work);
+        stack_impl_.get_work_manager()->set_work(work_host_index_, work);
     }
 }
 
 std::shared_ptr<stratum_work> stratum_connection::generate_work(
-    const std::string & job_id, const std::string & previous_hash,
-    const std::string & coinb1, const std::string & coinb2,
-    const std::vector<std::string> & merkles, const std::string & version,
-    const std::string & bits, const std::string & time
+    const std::string & job_id, const std::vector<std::uint8_t> & previous_hash,
+    const std::vector<std::uint8_t> & coinb1,
+    const std::vector<std::uint8_t> & coinb2,
+    const std::vector< std::vector<std::uint8_t> > & merkles,
+    const std::vector<std::uint8_t> & version,
+    const std::vector<std::uint8_t> & bits,
+    const std::vector<std::uint8_t> & time
     )
 {
     /**
      * Convert the difficulty to the target.
-     * @note If this were the Scrypt algorithm you would use
-     * m_next_difficulty / 65536.0
      */
     std::uint32_t target[8];
-
-	std::uint64_t m;
-
-    std::int32_t k;
-    
-    /**
-     * Set the difficulty.
-     */
-    auto difficulty = m_next_difficulty;
-    
-	for (k = 6; k > 0 && difficulty > 1.0; k--)
-    {
-		difficulty /= 4294967296.0;
-	}
-    
-    m = 4294901760.0 / difficulty;
-	
-    if (m == 0 && k == 6)
-	{
-    	std::memset(target, 0xff, 32);
-	}
-    else
-    {
-		std::memset(target, 0, 32);
-		
-        target[k] = static_cast<std::uint32_t> (m);
-		target[k + 1] = static_cast<std::uint32_t> (m >> 32);
-	}
     
-    /**
-     * Allocate the coinbase.
-     */
-    std::vector<std::uint8_t> coinbase;
-    
-    /**
-     * Convert previous_hash from hexidecimal.
-     */
-    auto previous_hash_bytes = utility::from_hex(previous_hash);
+    difficulty_to_target(m_next_difficulty, target);
     
-    /**
-     * Convert coinb1 from hexidecimal.
-     */
-    auto coinb1_bytes = utility::from_hex(coinb1);
+    auto ret = std::make_shared<stratum_work> (
+        username_, job_id, m_extranonce1, m_extranonce2,
+        previous_hash, coinb1, coinb2, merkles, version, bits, time, target
+    );
     
-    /**
-     * Convert coinb2 from hexidecimal.
-     */
-    auto coinb2_bytes = utility::from_hex(coinb2);
+    ret->set_target(target, m_next_difficulty);
     
-    /**
-     * Convert version from hexidecimal.
-     */
-    auto version_bytes = utility::from_hex(version);
+    return ret;
+}
+
+void stratum_connection::handle_mining_submit_result(
+    const bool & result, const submit_t & submit, const bool & stale
+    )
+{
+    auto latency = std::chrono::steady_clock::now() - submit.time_sent;
     
     /**
-     * Convert bits from hexidecimal.
+     * Record the latency and the job age (at the submit).
      */
-    auto bits_bytes = utility::from_hex(bits);
+    statistics::instance().record_submit(
+        pool_, latency, submit.time_sent - submit.time_notified, result,
+        stale
+    );
     
     /**
-     * Convert time from hexidecimal.
+     * Forward the result (of a proxied share).
      */
-    auto time_bytes = utility::from_hex(time);
-
-    auto ret = std::make_shared<stratum_work> (
-        stratum::instance().username(), job_id, m_extranonce1, m_extranonce2,
-        previous_hash_bytes, coinb1_bytes, coinb2_bytes, merkles,
-        version_bytes, bits_bytes, time_bytes, target
-    );
+    if (submit.handler)
+    {
+        submit.handler(result);
+    }
     
-    return ret;
-}
-
-void stratum_connection::handle_mining_submit_result(const bool & result)
-{
     if (result)
     {
         stratum::instance().set_shares_accepted(
@@ -833,8 +1512,14 @@ void stratum_connection::handle_mining_submit_result(const bool & result)
         shares_accepted << "/" << shares_accepted +
         shares_rejected << " (" << 100.0f * shares_accepted /
         (shares_accepted + shares_rejected) << "%) " <<
-        (result ? "accepted" : "rejected") << " at " <<
+        (result ? "accepted" : "rejected") << " in " <<
+        std::chrono::duration_cast<std::chrono::milliseconds> (
+        latency).count() << " ms at " <<
         std::fixed << std::setprecision(2) <<
-        statistics::instance().hashes_per_second() / 1000.0f << " KH/s."
+        statistics::instance().hashes_per_second() / 1000.0f << " KH/s" <<
+        (statistics::instance().watts() > 0.0 ? ", " : "") <<
+        (statistics::instance().watts() > 0.0 ?
+        std::to_string(statistics::instance().hashes_per_joule()) +
+        " H/J." : ".")
     );
 }
@@ -0,0 +1,366 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include <miner/stratum_parser.hpp>
+#include <miner/utility.hpp>
+
+using namespace miner;
+
+stratum_parser::stratum_parser()
+    : buf_(0)
+{
+    /**
+     * A mining.notify with a deep merkle branch is about 64 tokens.
+     */
+    tokens_.reserve(128);
+    stack_.reserve(8);
+}
+
+bool stratum_parser::parse(const char * buf, const std::size_t & len)
+{
+    buf_ = buf;
+    
+    /**
+     * Clear (but keep the capacity of) the tokens.
+     */
+    tokens_.clear();
+    stack_.clear();
+    
+    std::uint32_t pos = 0;
+    
+    while (pos < len)
+    {
+        auto c = buf_[pos];
+        
+        switch (c)
+        {
+            case '{':
+            case '[':
+            {
+                push(
+                    c == '{' ? token_type_object : token_type_array, pos,
+                    pos + 1
+                );
+                
+                stack_.push_back(static_cast<std::uint32_t> (
+                    tokens_.size() - 1)
+                );
+                
+                pos++;
+            }
+            break;
+            case '}':
+            case ']':
+            {
+                if (stack_.size() == 0)
+                {
+                    return false;
+                }
+                
+                auto & token = tokens_[stack_.back()];
+                
+                if (
+                    token.type != (c == '}' ? token_type_object :
+                    token_type_array)
+                    )
+                {
+                    return false;
+                }
+                
+                token.end = pos + 1;
+                token.next = static_cast<std::uint32_t> (tokens_.size());
+                
+                stack_.pop_back();
+                
+                pos++;
+            }
+            break;
+            case '"':
+            {
+                auto begin = ++pos;
+                
+                while (pos < len && buf_[pos] != '"')
+                {
+                    /**
+                     * Skip the escaped character.
+                     */
+                    if (buf_[pos] == '\\')
+                    {
+                        pos++;
+                    }
+                    
+                    pos++;
+                }
+                
+                if (pos >= len)
+                {
+                    return false;
+                }
+                
+                push(token_type_string, begin, pos);
+                
+                pos++;
+            }
+            break;
+            case ' ':
+            case '\t':
+            case '\r':
+            case '\n':
+            case ':':
+            case ',':
+            {
+                pos++;
+            }
+            break;
+            default:
+            {
+                auto begin = pos;
+                
+                while (
+                    pos < len && std::strchr(",]} \t\r\n:", buf_[pos]) == 0
+                    )
+                {
+                    pos++;
+                }
+                
+                push(token_type_primitive, begin, pos);
+            }
+            break;
+        }
+    }
+    
+    return tokens_.size() > 0 && stack_.size() == 0;
+}
+
+std::size_t stratum_parser::size() const
+{
+    return tokens_.size();
+}
+
+int stratum_parser::find(const int & index, const char * key) const
+{
+    if (index < 0 || tokens_[index].type != token_type_object)
+    {
+        return -1;
+    }
+    
+    /**
+     * The children of an object are key, value pairs.
+     */
+    auto i = index + 1;
+    
+    while (i < static_cast<int> (tokens_[index].next))
+    {
+        auto value = i + 1;
+        
+        if (value >= static_cast<int> (tokens_[index].next))
+        {
+            break;
+        }
+        
+        if (equals(i, key))
+        {
+            return value;
+        }
+        
+        i = next(value);
+    }
+    
+    return -1;
+}
+
+int stratum_parser::at(const int & index, const std::size_t & n) const
+{
+    if (index < 0 || tokens_[index].type != token_type_array)
+    {
+        return -1;
+    }
+    
+    auto i = index + 1;
+    
+    for (std::size_t j = 0; i < static_cast<int> (tokens_[index].next); j++)
+    {
+        if (j == n)
+        {
+            return i;
+        }
+        
+        i = next(i);
+    }
+    
+    return -1;
+}
+
+std::size_t stratum_parser::count(const int & index) const
+{
+    if (index < 0)
+    {
+        return 0;
+    }
+    
+    /**
+     * The children of an object are key, value pairs.
+     */
+    if (tokens_[index].type == token_type_object)
+    {
+        return tokens_[index].size / 2;
+    }
+    
+    return tokens_[index].size;
+}
+
+int stratum_parser::next(const int & index) const
+{
+    return static_cast<int> (tokens_[index].next);
+}
+
+bool stratum_parser::is_array(const int & index) const
+{
+    return index >= 0 && tokens_[index].type == token_type_array;
+}
+
+bool stratum_parser::is_null(const int & index) const
+{
+    return
+        index < 0 || (tokens_[index].type == token_type_primitive &&
+        equals(index, "null"))
+    ;
+}
+
+bool stratum_parser::equals(const int & index, const char * val) const
+{
+    if (index < 0)
+    {
+        return false;
+    }
+    
+    auto len = std::strlen(val);
+    
+    return
+        length(index) == len && std::memcmp(data(index), val, len) == 0
+    ;
+}
+
+const char * stratum_parser::data(const int & index) const
+{
+    return buf_ + tokens_[index].begin;
+}
+
+std::size_t stratum_parser::length(const int & index) const
+{
+    return tokens_[index].end - tokens_[index].begin;
+}
+
+std::string stratum_parser::to_string(const int & index) const
+{
+    if (index < 0)
+    {
+        return std::string();
+    }
+    
+    return std::string(data(index), length(index));
+}
+
+double stratum_parser::to_double(const int & index) const
+{
+    if (index < 0)
+    {
+        return 0.0;
+    }
+    
+    char buf[64];
+    
+    auto len = (std::min)(length(index), sizeof(buf) - 1);
+    
+    std::memcpy(buf, data(index), len);
+    
+    buf[len] = 0;
+    
+    return std::strtod(buf, 0);
+}
+
+std::uint64_t stratum_parser::to_uint64(const int & index) const
+{
+    std::uint64_t ret = 0;
+    
+    if (index >= 0)
+    {
+        auto ptr = data(index);
+        
+        for (std::size_t i = 0; i < length(index); i++)
+        {
+            if (ptr[i] < '0' || ptr[i] > '9')
+            {
+                break;
+            }
+            
+            ret = ret * 10 + (ptr[i] - '0');
+        }
+    }
+    
+    return ret;
+}
+
+bool stratum_parser::to_bool(const int & index) const
+{
+    return equals(index, "true");
+}
+
+bool stratum_parser::to_bytes(
+    const int & index, std::vector<std::uint8_t> & val
+    ) const
+{
+    if (index < 0 || tokens_[index].type != token_type_string)
+    {
+        return false;
+    }
+    
+    val.resize(length(index) / 2);
+    
+    return utility::from_hex(data(index), length(index), val.data());
+}
+
+void stratum_parser::push(
+    const token_type_t & type, const std::uint32_t & begin,
+    const std::uint32_t & end
+    )
+{
+    token_t token;
+    
+    token.type = type;
+    token.begin = begin;
+    token.end = end;
+    token.size = 0;
+    token.next = static_cast<std::uint32_t> (tokens_.size() + 1);
+    
+    /**
+     * Count the child of the open array or object.
+     */
+    if (stack_.size() > 0)
+    {
+        tokens_[stack_.back()].size++;
+    }
+    
+    tokens_.push_back(token);
+}
@@ -0,0 +1,297 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <miner/configuration.hpp>
+#include <miner/endpoint_cache.hpp>
+#include <miner/logger.hpp>
+#include <miner/stack_impl.hpp>
+#include <miner/stratum_probe.hpp>
+#include <miner/tcp_connector.hpp>
+#include <miner/work_manager.hpp>
+
+using namespace miner;
+
+/**
+ * The mining.subscribe request.
+ */
+static const char g_mining_subscribe[] =
+    "{\"id\": 1, \"method\": \"mining.subscribe\", \"params\": []}\n"
+;
+
+stratum_probe::stratum_probe(
+    stack_impl & owner, const std::uint32_t & work_host_index
+    )
+    : stack_impl_(owner)
+    , strand_(owner.io_service())
+    , timeout_timer_(owner.io_service())
+    , resolver_(owner.io_service())
+    , work_host_index_(work_host_index)
+    , port_(0)
+    , finished_(false)
+{
+    const auto & work_host =
+        configuration::instance().work_hosts()[work_host_index_]
+    ;
+    
+    host_ = work_host.second.first;
+    port_ = work_host.second.second;
+    
+    result_.success = false;
+    result_.rtt_connect = std::chrono::microseconds(0);
+    result_.rtt_subscribe = std::chrono::microseconds(0);
+}
+
+void stratum_probe::start()
+{
+    auto self(shared_from_this());
+    
+    /**
+     * The deadline of the whole probe.
+     */
+    timeout_timer_.expires_from_now(std::chrono::seconds(8));
+    timeout_timer_.async_wait(strand_.wrap(
+        [this, self](boost::system::error_code ec)
+        {
+            if (ec)
+            {
+                // ...
+            }
+            else
+            {
+                log_debug(
+                    "Stratum probe of work host " << work_host_index_ <<
+                    " timed out."
+                );
+                
+                finish(false);
+            }
+        })
+    );
+    
+    /**
+     * Start the coroutine on the strand.
+     */
+    stack_impl_.io_service().post(strand_.wrap(
+        std::bind(
+            &stratum_probe::run, self, boost::system::error_code(), 0
+        ))
+    );
+}
+
+void stratum_probe::stop()
+{
+    auto self(shared_from_this());
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self] ()
+        {
+            /**
+             * Close without reporting.
+             */
+            finished_ = true;
+            
+            timeout_timer_.cancel();
+            
+            resolver_.cancel();
+            
+            if (connector_)
+            {
+                connector_->cancel();
+            }
+            
+            if (socket_)
+            {
+                boost::system::error_code ec;
+                
+                socket_->close(ec);
+            }
+        })
+    );
+}
+
+#include <boost/asio/yield.hpp>
+
+void stratum_probe::run(const boost::system::error_code & ec, std::size_t len)
+{
+    if (finished_)
+    {
+        return;
+    }
+    else if (ec)
+    {
+        log_debug(
+            "Stratum probe of work host " << work_host_index_ <<
+            " failed, message = " << ec.message() << "."
+        );
+        
+        finish(false);
+        
+        return;
+    }
+    
+    auto self(shared_from_this());
+    
+    reenter (coroutine_)
+    {
+        if (endpoint_cache::instance().find(host_, port_, endpoints_) == false)
+        {
+            yield resolver_.async_resolve(
+                boost::asio::ip::tcp::resolver::query(
+                host_, std::to_string(port_)), strand_.wrap(
+                [this, self](boost::system::error_code ec,
+                boost::asio::ip::tcp::resolver::iterator it)
+                {
+                    if (ec)
+                    {
+                        // ...
+                    }
+                    else
+                    {
+                        endpoints_.assign(
+                            it, boost::asio::ip::tcp::resolver::iterator()
+                        );
+                        
+                        endpoint_cache::instance().insert(
+                            host_, port_, endpoints_
+                        );
+                    }
+                    
+                    run(ec, 0);
+                })
+            );
+        }
+        
+        time_connect_ = std::chrono::steady_clock::now();
+        
+        connector_ = std::make_shared<tcp_connector> (
+            stack_impl_.io_service(), strand_
+        );
+        
+        yield connector_->start(endpoints_,
+            [this, self](const boost::system::error_code & ec,
+            const std::shared_ptr<boost::asio::ip::tcp::socket> & socket)
+            {
+                if (ec)
+                {
+                    endpoint_cache::instance().erase(host_, port_);
+                }
+                else
+                {
+                    socket_ = socket;
+                }
+                
+                run(ec, 0);
+            }
+        );
+        
+        time_subscribe_ = std::chrono::steady_clock::now();
+        
+        result_.rtt_connect =
+            std::chrono::duration_cast<std::chrono::microseconds> (
+            time_subscribe_ - time_connect_)
+        ;
+        
+        yield boost::asio::async_write(
+            *socket_, boost::asio::buffer(
+            g_mining_subscribe, sizeof(g_mining_subscribe) - 1),
+            strand_.wrap(std::bind(
+            &stratum_probe::run, self, std::placeholders::_1,
+            std::placeholders::_2))
+        );
+        
+        /**
+         * Read until the mining.subscribe result (the pool may send other
+         * lines first).
+         */
+        for (;;)
+        {
+            yield boost::asio::async_read_until(
+                *socket_, response_, "\n", strand_.wrap(std::bind(
+                &stratum_probe::run, self, std::placeholders::_1,
+                std::placeholders::_2))
+            );
+            
+            {
+                auto buf = boost::asio::buffer_cast<const char *> (
+                    response_.data()
+                );
+                
+                if (
+                    parser_.parse(buf, len) &&
+                    parser_.to_uint64(parser_.find(0, "id")) == 1
+                    )
+                {
+                    result_.rtt_subscribe =
+                        std::chrono::duration_cast<
+                        std::chrono::microseconds> (
+                        std::chrono::steady_clock::now() - time_subscribe_)
+                    ;
+                    
+                    auto success =
+                        parser_.is_null(parser_.find(0, "result")) == false &&
+                        parser_.is_null(parser_.find(0, "error"))
+                    ;
+                    
+                    finish(success);
+                    
+                    return;
+                }
+                
+                response_.consume(len);
+            }
+        }
+    }
+}
+
+#include <boost/asio/unyield.hpp>
+
+void stratum_probe::finish(const bool & success)
+{
+    if (finished_)
+    {
+        return;
+    }
+    
+    finished_ = true;
+    
+    timeout_timer_.cancel();
+    
+    resolver_.cancel();
+    
+    if (connector_)
+    {
+        connector_->cancel();
+    }
+    
+    if (socket_)
+    {
+        boost::system::error_code ec;
+        
+        socket_->close(ec);
+    }
+    
+    result_.success = success;
+    result_.time = std::chrono::steady_clock::now();
+    
+    /**
+     * Report the result to the work manager.
+     */
+    stack_impl_.get_work_manager()->handle_probe(work_host_index_, result_);
+}
@@ -0,0 +1,314 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <sstream>
+
+#include <miner/logger.hpp>
+#include <miner/stack_impl.hpp>
+#include <miner/stratum_server.hpp>
+#include <miner/stratum_server_connection.hpp>
+#include <miner/stratum_work.hpp>
+#include <miner/utility.hpp>
+
+using namespace miner;
+
+stratum_server::stratum_server(stack_impl & owner)
+    : stack_impl_(owner)
+    , strand_(owner.io_service())
+    , acceptor_(owner.io_service())
+    , next_extranonce1_suffix_(1)
+{
+    // ...
+}
+
+void stratum_server::start(
+    const std::string & address, const std::uint16_t & port
+    )
+{
+    try
+    {
+        boost::asio::ip::tcp::endpoint endpoint(
+            boost::asio::ip::address::from_string(address), port
+        );
+        
+        acceptor_.open(endpoint.protocol());
+        acceptor_.set_option(
+            boost::asio::ip::tcp::acceptor::reuse_address(true)
+        );
+        acceptor_.bind(endpoint);
+        acceptor_.listen();
+    }
+    catch (std::exception & e)
+    {
+        log_error(
+            "Stratum server failed to listen on " << address << ":" << port <<
+            ", what = " << e.what() << "."
+        );
+        
+        return;
+    }
+    
+    log_info(
+        "Stratum server is listening on " << address << ":" << port << "."
+    );
+    
+    do_accept();
+}
+
+void stratum_server::stop()
+{
+    auto self(shared_from_this());
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self] ()
+        {
+            boost::system::error_code ec;
+            
+            acceptor_.close(ec);
+            
+            for (auto & i : stratum_server_connections_)
+            {
+                if (auto j = i.lock())
+                {
+                    j->stop();
+                }
+            }
+            
+            stratum_server_connections_.clear();
+        })
+    );
+}
+
+void stratum_server::set_work(const std::shared_ptr<stratum_work> & val)
+{
+    /**
+     * The downstream miners keep the previous job until the next one.
+     */
+    if (val == 0)
+    {
+        return;
+    }
+    else if (val->merkle_root().size() > 0)
+    {
+        log_debug("Stratum server cannot re-issue a header-only job.");
+        
+        return;
+    }
+    
+    auto self(shared_from_this());
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self, val] ()
+        {
+            mutex_.lock();
+            
+            /**
+             * The previous jobs are abandoned on a new block (or a switch
+             * to another work host).
+             */
+            auto clean_jobs =
+                work_ == 0 || work_->previous_hash() != val->previous_hash() ||
+                work_->work_host_index() != val->work_host_index()
+            ;
+            
+            work_ = val;
+            
+            mutex_.unlock();
+            
+            /**
+             * Render the mining.notify once for all downstream miners.
+             */
+            auto mining_notify = render_mining_notify(val, clean_jobs);
+            
+            auto it = stratum_server_connections_.begin();
+            
+            while (it != stratum_server_connections_.end())
+            {
+                if (auto connection = it->lock())
+                {
+                    connection->set_work(val, mining_notify);
+                    
+                    ++it;
+                }
+                else
+                {
+                    it = stratum_server_connections_.erase(it);
+                }
+            }
+        })
+    );
+}
+
+bool stratum_server::allocate_extranonce(
+    std::vector<std::uint8_t> & extranonce1, std::uint32_t & suffix,
+    std::size_t & suffix_size, std::size_t & extranonce2_size
+    )
+{
+    std::lock_guard<std::mutex> l1(mutex_);
+    
+    if (work_ == 0 || work_->extranonce2().size() < 2)
+    {
+        log_info("Stratum server has no upstream work to allocate from.");
+        
+        return false;
+    }
+    
+    /**
+     * Leave at least one byte of the upstream extranonce2 to the
+     * downstream miner.
+     */
+    suffix_size = (std::min)(
+        static_cast<std::size_t> (extranonce1_suffix_size),
+        work_->extranonce2().size() - 1
+    );
+    
+    auto suffixes = 1u << (8 * suffix_size);
+    
+    /**
+     * Find the next suffix not in use (wrapping around), zero is left to
+     * the local devices.
+     */
+    suffix = 0;
+    
+    for (auto i = 1u; i < suffixes; i++)
+    {
+        if (next_extranonce1_suffix_ >= suffixes)
+        {
+            next_extranonce1_suffix_ = 1;
+        }
+        
+        auto val = next_extranonce1_suffix_++;
+        
+        if (extranonce1_suffixes_.count(val) == 0)
+        {
+            suffix = val;
+            
+            break;
+        }
+    }
+    
+    if (suffix == 0)
+    {
+        log_error(
+            "Stratum server has no free extranonce1 suffix (" <<
+            extranonce1_suffixes_.size() << " in use)."
+        );
+        
+        return false;
+    }
+    
+    extranonce1_suffixes_.insert(suffix);
+    
+    extranonce1 = work_->extranonce1();
+    
+    for (auto i = suffix_size; i > 0; i--)
+    {
+        extranonce1.push_back(
+            static_cast<std::uint8_t> (suffix >> (8 * (i - 1)))
+        );
+    }
+    
+    extranonce2_size = work_->extranonce2().size() - suffix_size;
+    
+    return true;
+}
+
+void stratum_server::release_extranonce(const std::uint32_t & suffix)
+{
+    std::lock_guard<std::mutex> l1(mutex_);
+    
+    extranonce1_suffixes_.erase(suffix);
+}
+
+std::shared_ptr<stratum_work> stratum_server::work()
+{
+    std::lock_guard<std::mutex> l1(mutex_);
+    
+    return work_;
+}
+
+std::shared_ptr<std::string> stratum_server::render_mining_notify(
+    const std::shared_ptr<stratum_work> & work, const bool & clean_jobs
+    )
+{
+    std::stringstream ss;
+    
+    ss << "{\"id\": null, \"method\": \"mining.notify\", \"params\": [\"" <<
+        std::hex << work->job_handle() << std::dec << "\", \"" <<
+        utility::to_hex(work->previous_hash()) << "\", \"" <<
+        utility::to_hex(work->coinb1()) << "\", \"" <<
+        utility::to_hex(work->coinb2()) << "\", ["
+    ;
+    
+    for (std::size_t i = 0; i < work->merkles().size(); i++)
+    {
+        ss <<
+            (i > 0 ? ", \"" : "\"") << utility::to_hex(work->merkles()[i]) <<
+            "\""
+        ;
+    }
+    
+    ss <<
+        "], \"" << utility::to_hex(work->version()) << "\", \"" <<
+        utility::to_hex(work->bits()) << "\", \"" <<
+        utility::to_hex(work->time()) << "\", " <<
+        (clean_jobs ? "true" : "false") << "]}\n"
+    ;
+    
+    return std::make_shared<std::string> (ss.str());
+}
+
+void stratum_server::do_accept()
+{
+    auto self(shared_from_this());
+    
+    auto socket = std::make_shared<boost::asio::ip::tcp::socket> (
+        stack_impl_.io_service()
+    );
+    
+    acceptor_.async_accept(*socket, strand_.wrap(
+        [this, self, socket](boost::system::error_code ec)
+        {
+            if (acceptor_.is_open() == false)
+            {
+                return;
+            }
+            else if (ec)
+            {
+                log_error(
+                    "Stratum server accept failed, message = " <<
+                    ec.message() << "."
+                );
+            }
+            else
+            {
+                auto connection = std::make_shared<stratum_server_connection> (
+                    stack_impl_, *this, socket
+                );
+                
+                stratum_server_connections_.push_back(connection);
+                
+                connection->start();
+            }
+            
+            do_accept();
+        })
+    );
+}
@@ -0,0 +1,513 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cstring>
+#include <sstream>
+
+#include <miner/logger.hpp>
+#include <miner/share_queue.hpp>
+#include <miner/stack_impl.hpp>
+#include <miner/stratum_server.hpp>
+#include <miner/stratum_server_connection.hpp>
+#include <miner/stratum_work.hpp>
+#include <miner/utility.hpp>
+#include <miner/work_manager.hpp>
+
+using namespace miner;
+
+stratum_server_connection::stratum_server_connection(
+    stack_impl & owner, stratum_server & server,
+    const std::shared_ptr<boost::asio::ip::tcp::socket> & socket
+    )
+    : stack_impl_(owner)
+    , stratum_server_(server)
+    , strand_(owner.io_service())
+    , socket_(socket)
+    , request_(16384)
+    , upstream_extranonce1_size_(0)
+    , extranonce1_suffix_(0)
+    , extranonce2_size_(0)
+    , authorized_(false)
+    , difficulty_(0.0)
+    , closed_(false)
+{
+    boost::system::error_code ec;
+    
+    std::stringstream ss;
+    
+    ss << socket_->remote_endpoint(ec);
+    
+    remote_endpoint_ = ss.str();
+}
+
+void stratum_server_connection::start()
+{
+    log_info(
+        "Stratum server connection accepted " << remote_endpoint_ << "."
+    );
+    
+    /**
+     * Disable Nagle's algorithm so a job is sent immediately.
+     */
+    boost::system::error_code ec;
+    
+    socket_->set_option(boost::asio::ip::tcp::no_delay(true), ec);
+    
+    /**
+     * Start the coroutine on the strand.
+     */
+    stack_impl_.io_service().post(strand_.wrap(
+        std::bind(
+            &stratum_server_connection::run, shared_from_this(),
+            boost::system::error_code(), 0
+        ))
+    );
+}
+
+void stratum_server_connection::stop()
+{
+    auto self(shared_from_this());
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self] ()
+        {
+            close();
+        })
+    );
+}
+
+void stratum_server_connection::set_work(
+    const std::shared_ptr<stratum_work> & work,
+    const std::shared_ptr<std::string> & mining_notify
+    )
+{
+    auto self(shared_from_this());
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self, work, mining_notify] ()
+        {
+            if (closed_ || authorized_ == false)
+            {
+                return;
+            }
+            
+            /**
+             * If the upstream extranonce1 (or extranonce2 size) changed the
+             * extranonce1 of the downstream miner is no longer valid, it
+             * must reconnect.
+             */
+            if (
+                work->extranonce1().size() != upstream_extranonce1_size_ ||
+                std::equal(work->extranonce1().begin(),
+                work->extranonce1().end(), extranonce1_.begin()) == false ||
+                work->extranonce2().size() != extranonce1_.size() -
+                upstream_extranonce1_size_ + extranonce2_size_
+                )
+            {
+                log_info(
+                    "Stratum server connection " << remote_endpoint_ <<
+                    " upstream extranonce changed, closing."
+                );
+                
+                close();
+                
+                return;
+            }
+            
+            notify(work, mining_notify);
+        })
+    );
+}
+
+#include <boost/asio/yield.hpp>
+
+void stratum_server_connection::run(
+    const boost::system::error_code & ec, std::size_t len
+    )
+{
+    if (closed_)
+    {
+        return;
+    }
+    else if (ec)
+    {
+        log_info(
+            "Stratum server connection " << remote_endpoint_ <<
+            " closed, message = " << ec.message() << "."
+        );
+        
+        close();
+        
+        return;
+    }
+    
+    auto self(shared_from_this());
+    
+    reenter (coroutine_)
+    {
+        for (;;)
+        {
+            yield boost::asio::async_read_until(
+                *socket_, request_, "\n", strand_.wrap(std::bind(
+                &stratum_server_connection::run, self, std::placeholders::_1,
+                std::placeholders::_2))
+            );
+            
+            {
+                auto buf = boost::asio::buffer_cast<const char *> (
+                    request_.data()
+                );
+                
+                handle_json_line(buf, len);
+                
+                request_.consume(len);
+            }
+        }
+    }
+}
+
+#include <boost/asio/unyield.hpp>
+
+void stratum_server_connection::close()
+{
+    if (closed_)
+    {
+        return;
+    }
+    
+    closed_ = true;
+    
+    /**
+     * Release the extranonce1 suffix for another downstream miner.
+     */
+    if (extranonce1_suffix_ > 0)
+    {
+        stratum_server_.release_extranonce(extranonce1_suffix_);
+        
+        extranonce1_suffix_ = 0;
+    }
+    
+    boost::system::error_code ec;
+    
+    socket_->close(ec);
+}
+
+void stratum_server_connection::write(const std::shared_ptr<std::string> & buf)
+{
+    write_queue_.push_back(buf);
+    
+    /**
+     * If a write is in progress the buffer is coalesced into the next one.
+     */
+    if (writing_.size() == 0)
+    {
+        do_write();
+    }
+}
+
+void stratum_server_connection::do_write()
+{
+    if (closed_ || write_queue_.size() == 0)
+    {
+        return;
+    }
+    
+    writing_.assign(write_queue_.begin(), write_queue_.end());
+    
+    write_queue_.clear();
+    
+    write_buffers_.clear();
+    
+    for (auto & i : writing_)
+    {
+        write_buffers_.push_back(boost::asio::buffer(*i));
+    }
+    
+    auto self(shared_from_this());
+    
+    /**
+     * The buffers are retained until the write completes.
+     */
+    boost::asio::async_write(*socket_, write_buffers_, strand_.wrap(
+        [this, self](boost::system::error_code ec, std::size_t)
+        {
+            writing_.clear();
+            
+            if (ec)
+            {
+                close();
+            }
+            else
+            {
+                /**
+                 * Write anything queued during the write.
+                 */
+                do_write();
+            }
+        })
+    );
+}
+
+void stratum_server_connection::write_result(
+    const std::uint64_t & id, const std::string & result,
+    const std::string & error
+    )
+{
+    write(std::make_shared<std::string> (
+        "{\"id\": " + std::to_string(id) + ", \"result\": " + result +
+        ", \"error\": " + error + "}\n")
+    );
+}
+
+void stratum_server_connection::notify(
+    const std::shared_ptr<stratum_work> & work,
+    const std::shared_ptr<std::string> & mining_notify
+    )
+{
+    if (work->difficulty() != difficulty_)
+    {
+        difficulty_ = work->difficulty();
+        
+        std::stringstream ss;
+        
+        ss <<
+            "{\"id\": null, \"method\": \"mining.set_difficulty\", "
+            "\"params\": [" << difficulty_ << "]}\n"
+        ;
+        
+        write(std::make_shared<std::string> (ss.str()));
+    }
+    
+    write(mining_notify);
+}
+
+void stratum_server_connection::handle_json_line(
+    const char * buf, const std::size_t & len
+    )
+{
+    if (parser_.parse(buf, len) == false)
+    {
+        log_error(
+            "Stratum server connection " << remote_endpoint_ <<
+            " sent an invalid JSON-RPC line."
+        );
+        
+        close();
+        
+        return;
+    }
+    
+    auto method = parser_.find(0, "method");
+    auto params = parser_.find(0, "params");
+    
+    /**
+     * The id (zero if null).
+     */
+    auto id = parser_.to_uint64(parser_.find(0, "id"));
+    
+    if (parser_.equals(method, "mining.submit"))
+    {
+        handle_mining_submit(id, params);
+    }
+    else if (parser_.equals(method, "mining.subscribe"))
+    {
+        handle_mining_subscribe(id);
+    }
+    else if (parser_.equals(method, "mining.authorize"))
+    {
+        handle_mining_authorize(id, params);
+    }
+    else if (parser_.is_null(method) == false)
+    {
+        log_debug(
+            "Stratum server connection got unsupported method = " <<
+            parser_.to_string(method) << "."
+        );
+        
+        write_result(id, "null", "[20, \"Unsupported method\", null]");
+    }
+}
+
+void stratum_server_connection::handle_mining_subscribe(
+    const std::uint64_t & id
+    )
+{
+    std::size_t suffix_size = 0;
+    
+    /**
+     * A repeated mining.subscribe releases the previous suffix.
+     */
+    if (extranonce1_suffix_ > 0)
+    {
+        stratum_server_.release_extranonce(extranonce1_suffix_);
+        
+        extranonce1_suffix_ = 0;
+    }
+    
+    if (
+        stratum_server_.allocate_extranonce(
+        extranonce1_, extranonce1_suffix_, suffix_size,
+        extranonce2_size_) == false
+        )
+    {
+        log_info(
+            "Stratum server connection " << remote_endpoint_ <<
+            " could not be allocated an extranonce1."
+        );
+        
+        write_result(id, "null", "[20, \"Not ready\", null]");
+        
+        close();
+        
+        return;
+    }
+    
+    upstream_extranonce1_size_ = extranonce1_.size() - suffix_size;
+    
+    auto extranonce1 = utility::to_hex(extranonce1_);
+    
+    log_info(
+        "Stratum server connection " << remote_endpoint_ <<
+        " subscribed, extranonce1 = " << extranonce1 <<
+        ", extranonce2 size = " << extranonce2_size_ << "."
+    );
+    
+    write_result(
+        id, "[[[\"mining.set_difficulty\", \"" + extranonce1 + "\"], "
+        "[\"mining.notify\", \"" + extranonce1 + "\"]], \"" + extranonce1 +
+        "\", " + std::to_string(extranonce2_size_) + "]"
+    );
+}
+
+void stratum_server_connection::handle_mining_authorize(
+    const std::uint64_t & id, const int & params
+    )
+{
+    if (extranonce1_.size() == 0)
+    {
+        write_result(id, "null", "[25, \"Not subscribed\", null]");
+        
+        return;
+    }
+    
+    log_info(
+        "Stratum server connection " << remote_endpoint_ <<
+        " authorized worker " << parser_.to_string(parser_.at(params, 0)) <<
+        "."
+    );
+    
+    authorized_ = true;
+    
+    write_result(id, "true");
+    
+    /**
+     * Send the current job.
+     */
+    if (auto work = stratum_server_.work())
+    {
+        notify(work, stratum_server::render_mining_notify(work, true));
+    }
+}
+
+void stratum_server_connection::handle_mining_submit(
+    const std::uint64_t & id, const int & params
+    )
+{
+    if (authorized_ == false)
+    {
+        write_result(id, "null", "[24, \"Unauthorized worker\", null]");
+        
+        return;
+    }
+    
+    std::string job_id = parser_.to_string(parser_.at(params, 1));
+    
+    std::vector<std::uint8_t> extranonce2;
+    std::vector<std::uint8_t> time;
+    std::vector<std::uint8_t> nonce;
+    
+    auto valid =
+        parser_.count(params) >= 5 && job_id.size() > 0 &&
+        job_id.size() <= 8 &&
+        job_id.find_first_not_of("0123456789abcdef") == std::string::npos &&
+        parser_.to_bytes(parser_.at(params, 2), extranonce2) &&
+        parser_.to_bytes(parser_.at(params, 3), time) &&
+        parser_.to_bytes(parser_.at(params, 4), nonce) &&
+        extranonce2.size() == extranonce2_size_ && time.size() == 4 &&
+        nonce.size() == 4
+    ;
+    
+    share_queue::share_t share;
+    
+    auto suffix_size = extranonce1_.size() - upstream_extranonce1_size_;
+    
+    if (
+        valid == false ||
+        suffix_size + extranonce2.size() > sizeof(share.extranonce2)
+        )
+    {
+        write_result(id, "null", "[20, \"Invalid params\", null]");
+        
+        return;
+    }
+    
+    /**
+     * The job id is the job handle and the (upstream) extranonce2 is the
+     * suffix of our extranonce1 followed by the downstream extranonce2.
+     */
+    share.job_handle = static_cast<std::uint32_t> (
+        std::stoul(job_id, 0, 16)
+    );
+    
+    std::memcpy(
+        share.extranonce2, &extranonce1_[upstream_extranonce1_size_],
+        suffix_size
+    );
+    std::memcpy(
+        share.extranonce2 + suffix_size, extranonce2.data(),
+        extranonce2.size()
+    );
+    
+    share.extranonce2_size = static_cast<std::uint8_t> (
+        suffix_size + extranonce2.size()
+    );
+    
+    std::memcpy(share.time, time.data(), sizeof(share.time));
+    
+    share.nonce = utility::le32dec(nonce.data());
+    share.version = 0;
+    
+    auto self(shared_from_this());
+    
+    /**
+     * Forward the share, the result is written on our strand.
+     */
+    stack_impl_.get_work_manager()->submit_share(share,
+        [this, self, id](const bool & accepted)
+        {
+            stack_impl_.io_service().post(strand_.wrap(
+                [this, self, id, accepted] ()
+                {
+                    write_result(id, accepted ? "true" : "false");
+                })
+            );
+        }
+    );
+}
@@ -0,0 +1,846 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <cmath>
+#include <cstring>
+
+#include <miner/endpoint_cache.hpp>
+#include <miner/logger.hpp>
+#include <miner/stack_impl.hpp>
+#include <miner/statistics.hpp>
+#include <miner/stratum_probe.hpp>
+#include <miner/stratum_v2_connection.hpp>
+#include <miner/stratum_work.hpp>
+#include <miner/tcp_connector.hpp>
+#include <miner/utility.hpp>
+#include <miner/work_manager.hpp>
+
+using namespace miner;
+
+/**
+ * Appends an unsigned integer (little endian).
+ * @param buf The buffer.
+ * @param val The value.
+ * @param len The length in bytes.
+ */
+static void write_uint(
+    std::string & buf, const std::uint64_t & val, const std::size_t & len
+    )
+{
+    for (std::size_t i = 0; i < len; i++)
+    {
+        buf.push_back(static_cast<char> (val >> (8 * i)));
+    }
+}
+
+/**
+ * Appends a STR0_255 (or B0_32).
+ * @param buf The buffer.
+ * @param val The value.
+ */
+static void write_str0_255(std::string & buf, const std::string & val)
+{
+    auto len = (std::min)(val.size(), static_cast<std::size_t> (255));
+    
+    buf.push_back(static_cast<char> (len));
+    buf.append(val, 0, len);
+}
+
+/**
+ * Reads an unsigned integer (little endian).
+ * @param buf The buffer.
+ * @param len The length of the buffer.
+ * @param pos The position (advanced).
+ * @param size The size in bytes.
+ * @param val The value.
+ * @return False if the buffer is too short.
+ */
+static bool read_uint(
+    const std::uint8_t * buf, const std::size_t & len, std::size_t & pos,
+    const std::size_t & size, std::uint64_t & val
+    )
+{
+    if (pos + size > len)
+    {
+        return false;
+    }
+    
+    val = 0;
+    
+    for (std::size_t i = 0; i < size; i++)
+    {
+        val |= static_cast<std::uint64_t> (buf[pos + i]) << (8 * i);
+    }
+    
+    pos += size;
+    
+    return true;
+}
+
+/**
+ * Reads a number of bytes.
+ * @param buf The buffer.
+ * @param len The length of the buffer.
+ * @param pos The position (advanced).
+ * @param size The size in bytes.
+ * @param val The value.
+ * @return False if the buffer is too short.
+ */
+static bool read_bytes(
+    const std::uint8_t * buf, const std::size_t & len, std::size_t & pos,
+    const std::size_t & size, std::vector<std::uint8_t> & val
+    )
+{
+    if (pos + size > len)
+    {
+        return false;
+    }
+    
+    val.assign(buf + pos, buf + pos + size);
+    
+    pos += size;
+    
+    return true;
+}
+
+/**
+ * Reads a STR0_255 (or B0_32).
+ * @param buf The buffer.
+ * @param len The length of the buffer.
+ * @param pos The position (advanced).
+ * @param val The value.
+ * @return False if the buffer is too short.
+ */
+static bool read_str0_255(
+    const std::uint8_t * buf, const std::size_t & len, std::size_t & pos,
+    std::vector<std::uint8_t> & val
+    )
+{
+    std::uint64_t size = 0;
+    
+    return
+        read_uint(buf, len, pos, 1, size) &&
+        read_bytes(buf, len, pos, size, val)
+    ;
+}
+
+/**
+ * The (share) difficulty of a target (relative to the difficulty 1 target).
+ * @param target The target (8 words).
+ */
+static double target_to_difficulty(const std::uint32_t * target)
+{
+    auto val = 0.0;
+    
+    for (auto i = 7; i >= 0; i--)
+    {
+        val = val * 4294967296.0 + target[i];
+    }
+    
+    return val > 0.0 ? 65535.0 * std::pow(2.0, 208.0) / val : 1.0;
+}
+
+stratum_v2_connection::stratum_v2_connection(
+    stack_impl & owner, const std::uint32_t & work_host_index
+    )
+    : stratum_connection(owner, work_host_index)
+    , channel_id_(0)
+    , ntime_(0)
+    , nbits_(0)
+    , next_sequence_number_(0)
+{
+    std::memset(header_, 0, sizeof(header_));
+    std::memset(target_, 0xff, sizeof(target_));
+}
+
+void stratum_v2_connection::submit_header(
+    const share_queue::share_t & share,
+    const std::shared_ptr<stratum_work> & work, const submit_t & val
+    )
+{
+    auto self(std::static_pointer_cast<stratum_v2_connection> (
+        shared_from_this())
+    );
+    
+    /**
+     * The nonce, ntime and version of the header (the data is big endian
+     * words of the serialized header).
+     */
+    std::uint8_t nonce[4];
+    
+    utility::be32enc(nonce, share.nonce);
+    
+    auto payload = std::make_shared<std::string> ();
+    
+    payload->reserve(24);
+    
+    write_uint(*payload, channel_id_, 4);
+    write_uint(*payload, 0, 4);
+    write_uint(*payload, std::stoul(work->job_id()), 4);
+    write_uint(*payload, utility::le32dec(nonce), 4);
+    write_uint(*payload, utility::be32dec(share.time), 4);
+    write_uint(*payload, utility::be32dec(&work->version()[0]), 4);
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self, payload, val] ()
+        {
+            /**
+             * The connection was closed, the share is not written.
+             */
+            if (state() == state_stopped)
+            {
+                log_error(
+                    "Stratum V2 connection is stopped, dropping share."
+                );
+                
+                if (val.handler)
+                {
+                    val.handler(false);
+                }
+                
+                return;
+            }
+            
+            auto sequence_number = next_sequence_number_++;
+            
+            /**
+             * Patch the channel id (it may not have been known when the
+             * share was found) and the sequence number.
+             */
+            for (auto i = 0; i < 4; i++)
+            {
+                (*payload)[i] = static_cast<char> (channel_id_ >> (8 * i));
+                (*payload)[4 + i] =
+                    static_cast<char> (sequence_number >> (8 * i))
+                ;
+            }
+            
+            submits_[sequence_number] = val;
+            submits_[sequence_number].time_sent =
+                std::chrono::steady_clock::now()
+            ;
+            
+            write_message(message_type_submit_shares_standard, *payload);
+        })
+    );
+}
+
+void stratum_v2_connection::suggest_difficulty()
+{
+    // ...
+}
+
+#include <boost/asio/yield.hpp>
+
+void stratum_v2_connection::run(
+    const boost::system::error_code & ec, std::size_t
+    )
+{
+    if (state() == state_stopped)
+    {
+        return;
+    }
+    else if (ec)
+    {
+        log_error(
+            "Stratum V2 connection failed, message = " << ec.message() << "."
+        );
+        
+        /**
+         * Close the socket.
+         */
+        close();
+        
+        return;
+    }
+    
+    auto self(std::static_pointer_cast<stratum_v2_connection> (
+        shared_from_this())
+    );
+    
+    reenter (coroutine_)
+    {
+        set_state(state_resolving);
+        
+        /**
+         * Resolve unless the endpoints are cached.
+         */
+        if (endpoint_cache::instance().find(host_, port_, endpoints_) == false)
+        {
+            yield resolver_.async_resolve(
+                boost::asio::ip::tcp::resolver::query(
+                host_, std::to_string(port_)), strand_.wrap(
+                [this, self](boost::system::error_code ec,
+                boost::asio::ip::tcp::resolver::iterator it)
+                {
+                    if (ec)
+                    {
+                        // ...
+                    }
+                    else
+                    {
+                        endpoints_.assign(
+                            it, boost::asio::ip::tcp::resolver::iterator()
+                        );
+                        
+                        endpoint_cache::instance().insert(
+                            host_, port_, endpoints_
+                        );
+                    }
+                    
+                    run(ec, 0);
+                })
+            );
+        }
+        
+        set_state(state_connecting);
+        
+        connector_ = std::make_shared<tcp_connector> (
+            stack_impl_.io_service(), strand_
+        );
+        
+        time_connect_ = std::chrono::steady_clock::now();
+        
+        yield connector_->start(endpoints_,
+            [this, self](const boost::system::error_code & ec,
+            const std::shared_ptr<boost::asio::ip::tcp::socket> & socket)
+            {
+                if (ec)
+                {
+                    endpoint_cache::instance().erase(host_, port_);
+                }
+                else
+                {
+                    socket_ = socket;
+                }
+                
+                run(ec, 0);
+            }
+        );
+        
+        log_debug("Stratum V2 connection connected, setting up.");
+        
+        {
+            boost::system::error_code ec_no_delay;
+            
+            socket_->set_option(
+                boost::asio::ip::tcp::no_delay(true), ec_no_delay
+            );
+        }
+        
+        set_state(state_subscribing);
+        
+        time_subscribe_ = std::chrono::steady_clock::now();
+        
+        /**
+         * The SetupConnection (of the mining protocol requiring standard
+         * jobs).
+         */
+        {
+            std::string payload;
+            
+            write_uint(payload, 0, 1);
+            write_uint(payload, 2, 2);
+            write_uint(payload, 2, 2);
+            write_uint(payload, 1, 4);
+            write_str0_255(payload, host_);
+            write_uint(payload, port_, 2);
+            write_str0_255(payload, "minerpp");
+            write_str0_255(payload, "");
+            write_str0_255(payload, "");
+            write_str0_255(payload, "");
+            
+            write_message(message_type_setup_connection, payload);
+        }
+        
+        for (;;)
+        {
+            yield boost::asio::async_read(
+                *socket_, boost::asio::buffer(header_, sizeof(header_)),
+                strand_.wrap(std::bind(&stratum_v2_connection::run, self,
+                std::placeholders::_1, std::placeholders::_2))
+            );
+            
+            {
+                auto length =
+                    header_[3] | header_[4] << 8 | header_[5] << 16
+                ;
+                
+                if (length > max_payload_length)
+                {
+                    log_error(
+                        "Stratum V2 connection got oversized message (" <<
+                        length << " bytes)."
+                    );
+                    
+                    close();
+                    
+                    return;
+                }
+                
+                payload_.resize(length);
+            }
+            
+            yield boost::asio::async_read(
+                *socket_, boost::asio::buffer(payload_),
+                strand_.wrap(std::bind(&stratum_v2_connection::run, self,
+                std::placeholders::_1, std::placeholders::_2))
+            );
+            
+            {
+                auto extension_type = static_cast<std::uint16_t> (
+                    header_[0] | header_[1] << 8
+                );
+                
+                if (
+                    handle_message(extension_type, header_[2],
+                    payload_.data(), payload_.size()) == false
+                    )
+                {
+                    log_error(
+                        "Stratum V2 connection got malformed message, "
+                        "type = " << static_cast<int> (header_[2]) << "."
+                    );
+                    
+                    close();
+                    
+                    return;
+                }
+            }
+        }
+    }
+}
+
+#include <boost/asio/unyield.hpp>
+
+void stratum_v2_connection::write_message(
+    const message_type_t & type, const std::string & payload
+    )
+{
+    auto extension_type = 0;
+    
+    /**
+     * The messages of a channel have the channel message bit set.
+     */
+    if (
+        type == message_type_submit_shares_standard ||
+        type == message_type_new_mining_job ||
+        type == message_type_set_new_prev_hash ||
+        type == message_type_set_target
+        )
+    {
+        extension_type = channel_msg;
+    }
+    
+    std::string buf;
+    
+    buf.reserve(header_length + payload.size());
+    
+    write_uint(buf, extension_type, 2);
+    write_uint(buf, type, 1);
+    write_uint(buf, payload.size(), 3);
+    
+    buf.append(payload);
+    
+    write(buf);
+}
+
+bool stratum_v2_connection::handle_message(
+    const std::uint16_t & extension_type, const std::uint8_t & type,
+    const std::uint8_t * buf, const std::size_t & len
+    )
+{
+    /**
+     * Ignore the messages of extensions.
+     */
+    if ((extension_type & ~channel_msg) != 0)
+    {
+        return true;
+    }
+    
+    std::size_t pos = 0;
+    
+    switch (type)
+    {
+        case message_type_setup_connection_success:
+        {
+            log_info("Stratum V2 connection set up, opening channel.");
+            
+            set_state(state_authorizing);
+            
+            /**
+             * Report the round trip times of the handshake.
+             */
+            stratum_probe::result_t latency;
+            
+            latency.success = true;
+            latency.rtt_connect =
+                std::chrono::duration_cast<std::chrono::microseconds> (
+                time_subscribe_ - time_connect_)
+            ;
+            latency.rtt_subscribe =
+                std::chrono::duration_cast<std::chrono::microseconds> (
+                std::chrono::steady_clock::now() - time_subscribe_)
+            ;
+            latency.time = std::chrono::steady_clock::now();
+            
+            stack_impl_.get_work_manager()->handle_latency(
+                work_host_index_, latency
+            );
+            
+            /**
+             * The OpenStandardMiningChannel.
+             */
+            std::string payload;
+            
+            write_uint(payload, 1, 4);
+            write_str0_255(payload, username_);
+            
+            float hashes_per_second = static_cast<float> (
+                statistics::instance().hashes_per_second()
+            );
+            
+            std::uint32_t nominal_hash_rate = 0;
+            
+            std::memcpy(&nominal_hash_rate, &hashes_per_second, 4);
+            
+            write_uint(payload, nominal_hash_rate, 4);
+            payload.append(32, static_cast<char> (0xff));
+            
+            write_message(message_type_open_standard_mining_channel, payload);
+        }
+        break;
+        case message_type_setup_connection_error:
+        case message_type_open_mining_channel_error:
+        {
+            std::uint64_t val = 0;
+            std::vector<std::uint8_t> error_code;
+            
+            auto valid =
+                read_uint(buf, len, pos, 4, val) &&
+                read_str0_255(buf, len, pos, error_code)
+            ;
+            
+            log_error(
+                "Stratum V2 connection " <<
+                (type == message_type_setup_connection_error ?
+                "setup" : "open channel") << " failed, error = " <<
+                std::string(error_code.begin(), error_code.end()) << "."
+            );
+            
+            close();
+            
+            return valid;
+        }
+        break;
+        case message_type_open_standard_mining_channel_success:
+        {
+            std::uint64_t request_id = 0, channel_id = 0;
+            std::vector<std::uint8_t> target;
+            
+            if (
+                read_uint(buf, len, pos, 4, request_id) == false ||
+                read_uint(buf, len, pos, 4, channel_id) == false ||
+                read_bytes(buf, len, pos, 32, target) == false ||
+                read_str0_255(buf, len, pos, extranonce_prefix_) == false
+                )
+            {
+                return false;
+            }
+            
+            channel_id_ = static_cast<std::uint32_t> (channel_id);
+            
+            for (auto i = 0; i < 8; i++)
+            {
+                target_[i] = utility::le32dec(&target[i * 4]);
+            }
+            
+            log_info(
+                "Stratum V2 connection opened channel " << channel_id_ <<
+                ", extranonce prefix = " <<
+                utility::to_hex(extranonce_prefix_) << "."
+            );
+            
+            set_state(state_notifying);
+        }
+        break;
+        case message_type_new_mining_job:
+        {
+            auto time_start = std::chrono::steady_clock::now();
+            
+            std::uint64_t channel_id = 0, job_id = 0, has_min_ntime = 0;
+            std::uint64_t min_ntime = 0, version = 0;
+            
+            job_t job;
+            
+            if (
+                read_uint(buf, len, pos, 4, channel_id) == false ||
+                read_uint(buf, len, pos, 4, job_id) == false ||
+                read_uint(buf, len, pos, 1, has_min_ntime) == false ||
+                (has_min_ntime &&
+                read_uint(buf, len, pos, 4, min_ntime) == false) ||
+                read_uint(buf, len, pos, 4, version) == false ||
+                read_bytes(buf, len, pos, 32, job.merkle_root) == false
+                )
+            {
+                return false;
+            }
+            
+            job.version = static_cast<std::uint32_t> (version);
+            
+            if (has_min_ntime)
+            {
+                /**
+                 * The job is for the current previous hash.
+                 */
+                ntime_ = (std::max)(
+                    ntime_, static_cast<std::uint32_t> (min_ntime)
+                );
+                
+                generate_work(static_cast<std::uint32_t> (job_id), job);
+            }
+            else
+            {
+                /**
+                 * A future job (activated by a SetNewPrevHash).
+                 */
+                jobs_[static_cast<std::uint32_t> (job_id)] = job;
+                
+                /**
+                 * Only keep the recent future jobs.
+                 */
+                while (jobs_.size() > 8)
+                {
+                    jobs_.erase(jobs_.begin());
+                }
+            }
+            
+            log_debug(
+                "Stratum V2 connection handled NewMiningJob " << job_id <<
+                ", bytes = " << header_length + len << ", microseconds = " <<
+                std::chrono::duration_cast<std::chrono::microseconds> (
+                std::chrono::steady_clock::now() - time_start).count() << "."
+            );
+        }
+        break;
+        case message_type_set_new_prev_hash:
+        {
+            std::uint64_t channel_id = 0, job_id = 0, min_ntime = 0;
+            std::uint64_t nbits = 0;
+            
+            if (
+                read_uint(buf, len, pos, 4, channel_id) == false ||
+                read_uint(buf, len, pos, 4, job_id) == false ||
+                read_bytes(buf, len, pos, 32, previous_hash_) == false ||
+                read_uint(buf, len, pos, 4, min_ntime) == false ||
+                read_uint(buf, len, pos, 4, nbits) == false
+                )
+            {
+                return false;
+            }
+            
+            ntime_ = static_cast<std::uint32_t> (min_ntime);
+            nbits_ = static_cast<std::uint32_t> (nbits);
+            
+            log_info("Stratum V2 connection got work restart.");
+            
+            /**
+             * Inform the work manager of null work.
+             */
+            stack_impl_.get_work_manager()->set_work(work_host_index_, 0);
+            
+            auto it = jobs_.find(static_cast<std::uint32_t> (job_id));
+            
+            if (it != jobs_.end())
+            {
+                generate_work(it->first, it->second);
+            }
+            
+            /**
+             * The future jobs are for the previous block.
+             */
+            jobs_.clear();
+        }
+        break;
+        case message_type_set_target:
+        {
+            std::uint64_t channel_id = 0;
+            std::vector<std::uint8_t> target;
+            
+            if (
+                read_uint(buf, len, pos, 4, channel_id) == false ||
+                read_bytes(buf, len, pos, 32, target) == false
+                )
+            {
+                return false;
+            }
+            
+            for (auto i = 0; i < 8; i++)
+            {
+                target_[i] = utility::le32dec(&target[i * 4]);
+            }
+            
+            log_info("Stratum V2 connection got SetTarget.");
+            
+            /**
+             * Apply the target to the current job in place (and the next
+             * ones).
+             */
+            if (work_)
+            {
+                work_->set_target(target_, target_to_difficulty(target_));
+            }
+        }
+        break;
+        case message_type_submit_shares_success:
+        {
+            std::uint64_t channel_id = 0, last_sequence_number = 0;
+            
+            if (
+                read_uint(buf, len, pos, 4, channel_id) == false ||
+                read_uint(buf, len, pos, 4, last_sequence_number) == false
+                )
+            {
+                return false;
+            }
+            
+            /**
+             * The success acknowledges every submit up to the sequence
+             * number.
+             */
+            while (
+                submits_.size() > 0 &&
+                submits_.begin()->first <= last_sequence_number
+                )
+            {
+                auto submit = submits_.begin()->second;
+                
+                submits_.erase(submits_.begin());
+                
+                handle_mining_submit_result(true, submit);
+            }
+        }
+        break;
+        case message_type_submit_shares_error:
+        {
+            std::uint64_t channel_id = 0, sequence_number = 0;
+            std::vector<std::uint8_t> error_code;
+            
+            if (
+                read_uint(buf, len, pos, 4, channel_id) == false ||
+                read_uint(buf, len, pos, 4, sequence_number) == false ||
+                read_str0_255(buf, len, pos, error_code) == false
+                )
+            {
+                return false;
+            }
+            
+            auto it = submits_.find(sequence_number);
+            
+            if (it != submits_.end())
+            {
+                auto submit = it->second;
+                
+                submits_.erase(it);
+                
+                log_debug(
+                    "Stratum V2 connection share " << sequence_number <<
+                    " rejected, error = " <<
+                    std::string(error_code.begin(), error_code.end()) << "."
+                );
+                
+                handle_mining_submit_result(
+                    false, submit, std::string(error_code.begin(),
+                    error_code.end()) == "stale-share"
+                );
+            }
+        }
+        break;
+        default:
+        {
+            log_debug(
+                "Stratum V2 connection ignoring message type " <<
+                static_cast<int> (type) << "."
+            );
+        }
+        break;
+    }
+    
+    return true;
+}
+
+void stratum_v2_connection::generate_work(
+    const std::uint32_t & job_id, const job_t & job
+    )
+{
+    if (previous_hash_.size() != 32)
+    {
+        return;
+    }
+    
+    /**
+     * The first job ends the deadlines.
+     */
+    if (state() != state_mining)
+    {
+        set_state(state_mining);
+    }
+    
+    /**
+     * The stratum_work holds the fields as stratum (v1) sends them, the
+     * previous hash with it's words swapped and the version, nbits and
+     * ntime big endian.
+     */
+    std::vector<std::uint8_t> previous_hash(32);
+    
+    for (auto i = 0; i < 8; i++)
+    {
+        utility::be32enc(
+            &previous_hash[i * 4], utility::le32dec(&previous_hash_[i * 4])
+        );
+    }
+    
+    std::vector<std::uint8_t> version(4), bits(4), time(4);
+    
+    utility::be32enc(&version[0], job.version);
+    utility::be32enc(&bits[0], nbits_);
+    utility::be32enc(&time[0], ntime_);
+    
+    auto work = std::make_shared<stratum_work> (
+        username_, std::to_string(job_id), extranonce_prefix_,
+        std::vector<std::uint8_t> (), previous_hash,
+        std::vector<std::uint8_t> (), std::vector<std::uint8_t> (),
+        std::vector< std::vector<std::uint8_t> > (), version, bits, time,
+        target_
+    );
+    
+    work->set_merkle_root(job.merkle_root);
+    
+    work->set_target(target_, target_to_difficulty(target_));
+    
+    work->set_time_notified(std::chrono::steady_clock::now());
+    
+    work_ = work;
+    
+    /**
+     * Inform the work manager of the new work.
+     */
+    stack_impl_.get_work_manager()->set_work(work_host_index_, work);
+}
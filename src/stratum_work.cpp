@@ -19,6 +19,7 @@
  */
 
 #include <cassert>
+#include <cstring>
 
 #include <miner/sha256.hpp>
 #include <miner/stratum_work.hpp>
@@ -34,7 +35,7 @@ stratum_work::stratum_work(
     const std::vector<std::uint8_t> & previous_hash_bytes,
     const std::vector<std::uint8_t> & coinb1_bytes,
     const std::vector<std::uint8_t> & coinb2_bytes,
-    const std::vector<std::string> & merkles,
+    const std::vector< std::vector<std::uint8_t> > & merkles,
     const std::vector<std::uint8_t> & version_bytes,
     const std::vector<std::uint8_t> & bits_bytes,
     const std::vector<std::uint8_t> & time_bytes,
@@ -51,56 +52,63 @@ stratum_work::stratum_work(
     , m_version_bytes(version_bytes)
     , m_bits_bytes(bits_bytes)
     , m_time(time_bytes)
+    , m_target(std::make_shared<target_t> ())
+    , m_job_handle(0)
+    , m_work_host_index(0)
+    , m_generation(0)
 {
-    m_target.insert(
-        m_target.begin(), target, target + sizeof(std::uint32_t) * 8
-    );
+    std::memcpy(m_target->words, target, sizeof(m_target->words));
     
-    assert(m_target.size() == 32);
+    m_target->difficulty = 1.0;
 }
 
 bool stratum_work::generate()
 {
-    /**
-     * Allocate the coinbase.
-     */
-    std::vector<std::uint8_t> coinbase;
-
-    /**
-     * Concatenate coinb1 + m_extranonce1 + m_extranonce2 + coinb2.
-     */
-    coinbase.insert(
-        coinbase.end(), m_coinb1_bytes.begin(), m_coinb1_bytes.end()
-    );
-    coinbase.insert(
-        coinbase.end(), m_extranonce1.begin(), m_extranonce1.end()
-    );
-    coinbase.insert(
-        coinbase.end(), m_extranonce2.begin(), m_extranonce2.end()
-    );
-    coinbase.insert(
-        coinbase.end(), m_coinb2_bytes.begin(), m_coinb2_bytes.end()
-    );
-
-    /**
-     * Generate merkle root.
-     */
     std::vector<std::uint8_t> digest_merkle_root(64, 0);
-
-    sha256d(&coinbase[0], coinbase.size(), &digest_merkle_root[0]);
-
-    for (auto & i : m_merkles)
+    
+    if (m_merkle_root.size() == 32)
     {
-        auto merkle_bytes = utility::from_hex(i);
-        
-        assert(merkle_bytes.size() == 32);
+        /**
+         * The merkle root is given (header-only).
+         */
+        std::memcpy(&digest_merkle_root[0], m_merkle_root.data(), 32);
+    }
+    else
+    {
+        /**
+         * Allocate the coinbase.
+         */
+        std::vector<std::uint8_t> coinbase;
         
-        std::memcpy(
-            &digest_merkle_root[0] + 32, merkle_bytes.data(),
-            merkle_bytes.size()
+        /**
+         * Concatenate coinb1 + m_extranonce1 + m_extranonce2 + coinb2.
+         */
+        coinbase.insert(
+            coinbase.end(), m_coinb1_bytes.begin(), m_coinb1_bytes.end()
+        );
+        coinbase.insert(
+            coinbase.end(), m_extranonce1.begin(), m_extranonce1.end()
         );
+        coinbase.insert(
+            coinbase.end(), m_extranonce2.begin(), m_extranonce2.end()
+        );
+        coinbase.insert(
+            coinbase.end(), m_coinb2_bytes.begin(), m_coinb2_bytes.end()
+        );
+        
+        /**
+         * Generate merkle root.
+         */
+        sha256d(&coinbase[0], coinbase.size(), &digest_merkle_root[0]);
         
-        sha256d(&digest_merkle_root[0], 64, &digest_merkle_root[0]);
+        for (auto & i : m_merkles)
+        {
+            assert(i.size() == 32);
+            
+            std::memcpy(&digest_merkle_root[0] + 32, i.data(), i.size());
+            
+            sha256d(&digest_merkle_root[0], 64, &digest_merkle_root[0]);
+        }
     }
 
     /**
@@ -162,17 +170,160 @@ const std::vector<std::uint8_t> & stratum_work::extranonce2() const
     return m_extranonce2;
 }
 
+const std::vector<std::uint8_t> & stratum_work::previous_hash() const
+{
+    return m_previous_hash_bytes;
+}
+
 const std::vector<std::uint8_t> & stratum_work::time() const
 {
     return m_time;
 }
 
+const std::vector<std::uint8_t> & stratum_work::extranonce1() const
+{
+    return m_extranonce1;
+}
+
+const std::vector<std::uint8_t> & stratum_work::coinb1() const
+{
+    return m_coinb1_bytes;
+}
+
+const std::vector<std::uint8_t> & stratum_work::coinb2() const
+{
+    return m_coinb2_bytes;
+}
+
+const std::vector< std::vector<std::uint8_t> > &
+    stratum_work::merkles() const
+{
+    return m_merkles;
+}
+
+const std::vector<std::uint8_t> & stratum_work::version() const
+{
+    return m_version_bytes;
+}
+
+const std::vector<std::uint8_t> & stratum_work::bits() const
+{
+    return m_bits_bytes;
+}
+
+void stratum_work::set_merkle_root(const std::vector<std::uint8_t> & val)
+{
+    m_merkle_root = val;
+}
+
+const std::vector<std::uint8_t> & stratum_work::merkle_root() const
+{
+    return m_merkle_root;
+}
+
+void stratum_work::set_target(
+    const std::uint32_t * val, const double & difficulty
+    )
+{
+    std::lock_guard<std::mutex> l1(m_target->mutex);
+    
+    std::memcpy(m_target->words, val, sizeof(m_target->words));
+    
+    m_target->difficulty = difficulty;
+}
+
+void stratum_work::target(std::uint32_t * val) const
+{
+    std::lock_guard<std::mutex> l1(m_target->mutex);
+    
+    std::memcpy(val, m_target->words, sizeof(m_target->words));
+}
+
+double stratum_work::difficulty() const
+{
+    std::lock_guard<std::mutex> l1(m_target->mutex);
+    
+    return m_target->difficulty;
+}
+
 std::vector<std::uint32_t> & stratum_work::data()
 {
     return m_data;
 }
 
-const std::uint32_t * stratum_work::target() const
+void stratum_work::set_time_notified(
+    const std::chrono::steady_clock::time_point & val
+    )
+{
+    m_time_notified = val;
+}
+
+const std::chrono::steady_clock::time_point &
+    stratum_work::time_notified() const
+{
+    return m_time_notified;
+}
+
+void stratum_work::set_job_handle(const std::uint32_t & val)
+{
+    m_job_handle = val;
+}
+
+const std::uint32_t & stratum_work::job_handle() const
+{
+    return m_job_handle;
+}
+
+void stratum_work::set_work_host_index(const std::uint32_t & val)
+{
+    m_work_host_index = val;
+}
+
+const std::uint32_t & stratum_work::work_host_index() const
+{
+    return m_work_host_index;
+}
+
+void stratum_work::set_generation(const std::uint32_t & val)
+{
+    m_generation = val;
+}
+
+const std::uint32_t & stratum_work::generation() const
+{
+    return m_generation;
+}
+
+void stratum_work::render_submit_template()
+{
+    auto ret = std::make_shared<submit_template_t> ();
+    
+    ret->json =
+        "{\"params\": [\"" + m_worker_name + "\", \"" + m_job_id + "\", \""
+    ;
+    
+    ret->extranonce2_offset = ret->json.size();
+    ret->extranonce2_length = m_extranonce2.size() * 2;
+    ret->json.append(ret->extranonce2_length, '0');
+    ret->json += "\", \"";
+    
+    ret->time_offset = ret->json.size();
+    ret->json.append(8, '0');
+    ret->json += "\", \"";
+    
+    ret->nonce_offset = ret->json.size();
+    ret->json.append(8, '0');
+    ret->json += "\"], \"id\": ";
+    
+    ret->id_offset = ret->json.size();
+    ret->json.append(submit_id_length, ' ');
+    ret->json += ", \"method\": \"mining.submit\"}\n";
+    
+    m_submit_template = ret;
+}
+
+const std::shared_ptr<const stratum_work::submit_template_t> &
+    stratum_work::submit_template() const
 {
-    return &m_target[0];
+    return m_submit_template;
 }
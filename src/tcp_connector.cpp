@@ -0,0 +1,218 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <algorithm>
+
+#include <miner/logger.hpp>
+#include <miner/tcp_connector.hpp>
+
+using namespace miner;
+
+tcp_connector::tcp_connector(
+    boost::asio::io_service & ios, boost::asio::strand & s
+    )
+    : io_service_(ios)
+    , strand_(s)
+    , timer_(ios)
+    , next_(0)
+    , pending_(0)
+    , finished_(false)
+{
+    // ...
+}
+
+void tcp_connector::start(
+    const std::vector<boost::asio::ip::tcp::endpoint> & endpoints,
+    const handler_t & f
+    )
+{
+    handler_ = f;
+    
+    /**
+     * Interleave the address families starting with the family of the
+     * first (preferred) endpoint.
+     */
+    std::vector<boost::asio::ip::tcp::endpoint> preferred;
+    std::vector<boost::asio::ip::tcp::endpoint> other;
+    
+    for (auto & i : endpoints)
+    {
+        if (i.protocol() == endpoints.front().protocol())
+        {
+            preferred.push_back(i);
+        }
+        else
+        {
+            other.push_back(i);
+        }
+    }
+    
+    for (std::size_t i = 0; i < preferred.size() || i < other.size(); i++)
+    {
+        if (i < preferred.size())
+        {
+            endpoints_.push_back(preferred[i]);
+        }
+        
+        if (i < other.size())
+        {
+            endpoints_.push_back(other[i]);
+        }
+    }
+    
+    auto self(shared_from_this());
+    
+    io_service_.post(strand_.wrap(
+        [this, self] ()
+        {
+            if (endpoints_.size() == 0)
+            {
+                finish(boost::asio::error::host_not_found, 0);
+            }
+            else
+            {
+                connect_next();
+            }
+        })
+    );
+}
+
+void tcp_connector::cancel()
+{
+    finished_ = true;
+    
+    /**
+     * Release the handler (and whatever it retains).
+     */
+    handler_ = 0;
+    
+    timer_.cancel();
+    
+    for (auto & i : sockets_)
+    {
+        boost::system::error_code ec;
+        
+        i->close(ec);
+    }
+    
+    sockets_.clear();
+}
+
+void tcp_connector::connect_next()
+{
+    if (finished_ || next_ >= endpoints_.size())
+    {
+        return;
+    }
+    
+    auto self(shared_from_this());
+    
+    auto socket = std::make_shared<boost::asio::ip::tcp::socket> (
+        io_service_
+    );
+    
+    sockets_.push_back(socket);
+    
+    const auto & endpoint = endpoints_[next_++];
+    
+    log_debug("TCP connector is connecting to " << endpoint << ".");
+    
+    pending_++;
+    
+    socket->async_connect(endpoint, strand_.wrap(
+        [this, self, socket](boost::system::error_code ec)
+        {
+            pending_--;
+            
+            if (finished_)
+            {
+                return;
+            }
+            else if (ec)
+            {
+                log_debug(
+                    "TCP connector attempt failed, message = " <<
+                    ec.message() << "."
+                );
+                
+                if (next_ < endpoints_.size())
+                {
+                    /**
+                     * Start the next attempt without waiting for the delay.
+                     */
+                    connect_next();
+                }
+                else if (pending_ == 0)
+                {
+                    finish(ec, 0);
+                }
+            }
+            else
+            {
+                finish(ec, socket);
+            }
+        })
+    );
+    
+    if (next_ < endpoints_.size())
+    {
+        /**
+         * Setting the expiry cancels the delay of the previous attempt.
+         */
+        timer_.expires_from_now(
+            std::chrono::milliseconds(connection_attempt_delay)
+        );
+        timer_.async_wait(strand_.wrap(
+            [this, self](boost::system::error_code ec)
+            {
+                if (ec)
+                {
+                    // ...
+                }
+                else
+                {
+                    connect_next();
+                }
+            })
+        );
+    }
+}
+
+void tcp_connector::finish(
+    const boost::system::error_code & ec,
+    const std::shared_ptr<boost::asio::ip::tcp::socket> & socket
+    )
+{
+    auto f = handler_;
+    
+    /**
+     * Keep the winning socket open and close the losing attempts.
+     */
+    sockets_.erase(
+        std::remove(sockets_.begin(), sockets_.end(), socket), sockets_.end()
+    );
+    
+    cancel();
+    
+    if (f)
+    {
+        f(ec, socket);
+    }
+}
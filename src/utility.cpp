@@ -24,29 +24,29 @@
 
 using namespace miner;
 
+static const std::int8_t g_hex_digit[256] =
+{
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1,
+    -1,0xa,0xb,0xc,0xd,0xe,0xf,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,0xa,0xb,0xc,0xd,0xe,0xf,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+    -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
+};
+
 std::vector<std::uint8_t> utility::from_hex(const std::string & val)
 {
     std::vector<std::uint8_t> ret;
-    
-    static const std::int8_t g_hex_digit[256] =
-    {
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        0, 1, 2, 3, 4, 5, 6, 7, 8, 9, -1, -1, -1, -1, -1, -1,
-        -1,0xa,0xb,0xc,0xd,0xe,0xf,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,0xa,0xb,0xc,0xd,0xe,0xf,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-        -1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,-1,
-    };
 
     const char * ptr = val.c_str();
 
@@ -81,6 +81,34 @@ std::vector<std::uint8_t> utility::from_hex(const std::string & val)
     return ret;
 }
 
+bool utility::from_hex(
+    const char * val, const std::size_t & len, std::uint8_t * out
+    )
+{
+    if (len % 2 != 0)
+    {
+        return false;
+    }
+    
+    for (std::size_t i = 0; i < len; i += 2)
+    {
+        auto hi = g_hex_digit[static_cast<std::uint8_t> (val[i])];
+        auto lo = g_hex_digit[static_cast<std::uint8_t> (val[i + 1])];
+        
+        if (
+            hi == static_cast<std::int8_t> (-1) ||
+            lo == static_cast<std::int8_t> (-1)
+            )
+        {
+            return false;
+        }
+        
+        *out++ = static_cast<std::uint8_t> ((hi << 4) | lo);
+    }
+    
+    return true;
+}
+
 std::string utility::to_hex(
     const std::vector<std::uint8_t> & bytes, const bool & spaces
     )
@@ -88,6 +116,23 @@ std::string utility::to_hex(
     return to_hex(bytes.begin(), bytes.end(), spaces);
 }
 
+void utility::to_hex(
+    const std::uint8_t * val, const std::size_t & len, char * out
+    )
+{
+    static const char hexmap[16] =
+    {
+        '0', '1', '2', '3', '4', '5', '6', '7', '8', '9',
+        'a', 'b', 'c', 'd', 'e', 'f'
+    };
+    
+    for (std::size_t i = 0; i < len; i++)
+    {
+        *out++ = hexmap[val[i] >> 4];
+        *out++ = hexmap[val[i] & 15];
+    }
+}
+
 void utility::le32enc(void * val, std::uint32_t x)
 {
     std::uint8_t * p = (std::uint8_t *)val;
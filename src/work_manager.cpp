@@ -18,13 +18,20 @@
  * along with this program. If not, see <http://www.gnu.org/licenses/>.
  */
 
+#include <algorithm>
 #include <cassert>
+#include <cstring>
+#include <limits>
+#include <thread>
 
 #include <miner/configuration.hpp>
 #include <miner/logger.hpp>
 #include <miner/stack_impl.hpp>
+#include <miner/statistics.hpp>
 #include <miner/stratum.hpp>
 #include <miner/stratum_connection.hpp>
+#include <miner/stratum_probe.hpp>
+#include <miner/stratum_v2_connection.hpp>
 #include <miner/stratum_work.hpp>
 #include <miner/utility.hpp>
 #include <miner/work_manager.hpp>
@@ -35,133 +42,1256 @@ work_manager::work_manager(stack_impl & owner)
     : stack_impl_(owner)
     , strand_(owner.io_service())
     , timer_(owner.io_service())
-    , timer_check_work_hosts_(owner.io_service())
+    , election_index_(0)
+    , election_count_(0)
+    , stopped_(false)
     , work_host_index_(0)
+    , timer_check_work_hosts_(owner.io_service())
+    , drain_shares_pending_(false)
+    , job_handle_(0)
 {
     // ...
 }
 
-void work_manager::start()
+void work_manager::start()
+{
+    if (configuration::instance().work_hosts().size() > 0)
+    {
+        select_work_host(0);
+    }
+    else
+    {
+        throw std::runtime_error("no work hosts");
+    }
+    
+    stopped_ = false;
+    
+    timer_.expires_from_now(std::chrono::seconds(8));
+    timer_.async_wait(strand_.wrap(std::bind(
+        &work_manager::tick, this, std::placeholders::_1))
+    );
+    
+    timer_check_work_hosts_.expires_from_now(std::chrono::seconds(60));
+    timer_check_work_hosts_.async_wait(strand_.wrap(std::bind(
+        &work_manager::tick_check_work_hosts, this, std::placeholders::_1))
+    );
+    
+    auto self(shared_from_this());
+    
+    /**
+     * Connect to the work server (and the backups).
+     */
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self] ()
+        {
+            connect_work_hosts();
+        })
+    );
+}
+
+void work_manager::stop()
+{
+    stopped_ = true;
+    
+    auto self(shared_from_this());
+    
+    /**
+     * The stratum connections and probes are (re)allocated on the strand.
+     */
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self] ()
+        {
+            timer_.cancel();
+            timer_check_work_hosts_.cancel();
+            
+            for (auto & i : stratum_connections_)
+            {
+                if (auto j = i.second.lock())
+                {
+                    j->stop();
+                }
+            }
+            
+            for (auto & i : stratum_probes_)
+            {
+                if (auto j = i.second.lock())
+                {
+                    j->stop();
+                }
+            }
+        })
+    );
+}
+
+void work_manager::set_work(
+    const std::uint32_t & work_host_index,
+    const std::shared_ptr<stratum_work> & val
+    )
+{
+    if (val == 0)
+    {
+        std::lock_guard<std::mutex> l1(mutex_jobs_);
+        
+        /**
+         * A work restart (clean jobs) invalidates the previous jobs of the
+         * work host.
+         */
+        generations_[work_host_index]++;
+    }
+    else
+    {
+        std::lock_guard<std::mutex> l1(mutex_jobs_);
+        
+        /**
+         * Assign the job handle the shares will refer to, the work host
+         * they are submitted to and the generation they are valid in.
+         */
+        val->set_job_handle(++job_handle_);
+        val->set_work_host_index(work_host_index);
+        val->set_generation(generations_[work_host_index]);
+        
+        /**
+         * Render the mining.submit template the shares are patched into
+         * (unless the job is header-only).
+         */
+        if (val->merkle_root().size() == 0)
+        {
+            val->render_submit_template();
+        }
+        
+        jobs_[job_handle_] = val;
+        
+        /**
+         * Only keep the recent jobs.
+         */
+        while (jobs_.size() > 32)
+        {
+            jobs_.erase(jobs_.begin());
+        }
+        
+        /**
+         * The submitted shares are kept as long as the latest job handle
+         * of the job is.
+         */
+        submitted_[
+            std::make_tuple(
+                work_host_index, val->extranonce1(), val->job_id()
+            )
+        ].job_handle = job_handle_;
+        
+        auto it = submitted_.begin();
+        
+        while (it != submitted_.end())
+        {
+            if (it->second.job_handle < jobs_.begin()->first)
+            {
+                it = submitted_.erase(it);
+            }
+            else
+            {
+                ++it;
+            }
+        }
+    }
+    
+    auto self(shared_from_this());
+    
+    /**
+     * The stratum_connection calls us from it's own strand so assign the
+     * work on ours.
+     */
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self, work_host_index, val] ()
+        {
+            /**
+             * Cache the latest work of every work host.
+             */
+            works_[work_host_index] = val;
+            
+            if (val)
+            {
+                record_notify(work_host_index, val);
+            }
+            
+            if (is_split())
+            {
+                /**
+                 * Hand the work of every work host to the devices.
+                 */
+                stack_impl_.handle_works(works_);
+            }
+            else if (work_host_index == work_host_index_)
+            {
+                m_work = val;
+                
+                stack_impl_.handle_work(m_work);
+            }
+            else if (
+                val && work_host_index < work_host_index_ &&
+                stopped_ == false && configuration::instance(
+                ).pool_selection() == configuration::pool_selection_order
+                )
+            {
+                log_info(
+                    "Work manager work host " << work_host_index <<
+                    " is mining again."
+                );
+                
+                /**
+                 * Switch back to the (higher priority) work host.
+                 */
+                select_work_host(work_host_index);
+                
+                m_work = val;
+                
+                stack_impl_.handle_work(m_work);
+                
+                connect_work_hosts();
+            }
+        })
+    );
+}
+
+void work_manager::handle_disconnect(const std::uint32_t & work_host_index)
+{
+    auto self(shared_from_this());
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self, work_host_index] ()
+        {
+            works_.erase(work_host_index);
+            
+            /**
+             * The first notify after a reconnect is not a new block.
+             */
+            previous_hashes_.erase(work_host_index);
+            
+            if (is_split())
+            {
+                /**
+                 * Move the devices of the work host to the others.
+                 */
+                stack_impl_.handle_works(works_);
+            }
+            else if (
+                stopped_ == false && work_host_index == work_host_index_
+                )
+            {
+                failover(work_host_index);
+            }
+        })
+    );
+}
+
+void work_manager::handle_probe(
+    const std::uint32_t & work_host_index, const stratum_probe::result_t & val
+    )
+{
+    auto self(shared_from_this());
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self, work_host_index, val] ()
+        {
+            /**
+             * Record the result (and round trip times) of the work host.
+             */
+            probes_[work_host_index] = val;
+            
+            if (val.success)
+            {
+                record_latency(work_host_index, val);
+                
+                log_info(
+                    "Work manager work host " << work_host_index <<
+                    " probe success, connect = " << val.rtt_connect.count() <<
+                    " microseconds, subscribe = " <<
+                    val.rtt_subscribe.count() << " microseconds."
+                );
+            }
+            else
+            {
+                log_info(
+                    "Work manager work host " << work_host_index <<
+                    " probe failed."
+                );
+            }
+            
+            /**
+             * If the primary is reachable again switch back to it (unless
+             * the work hosts are elected by latency).
+             */
+            if (
+                val.success && work_host_index == 0 && work_host_index_ > 0 &&
+                is_split() == false &&
+                stopped_ == false && configuration::instance(
+                ).pool_selection() == configuration::pool_selection_order
+                )
+            {
+                select_work_host(0);
+                
+                /**
+                 * Connect to the work server (disconnecting the backup work
+                 * hosts that are no longer needed).
+                 */
+                connect_work_hosts();
+            }
+        })
+    );
+}
+
+void work_manager::handle_latency(
+    const std::uint32_t & work_host_index, const stratum_probe::result_t & val
+    )
+{
+    auto self(shared_from_this());
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self, work_host_index, val] ()
+        {
+            record_latency(work_host_index, val);
+        })
+    );
+}
+
+void work_manager::set_session(
+    const std::uint32_t & work_host_index, const std::string & session_id,
+    const std::vector<std::uint8_t> & extranonce1,
+    const std::size_t & extranonce2_size
+    )
+{
+    auto self(shared_from_this());
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self, work_host_index, session_id, extranonce1,
+        extranonce2_size] ()
+        {
+            if (session_id.size() == 0)
+            {
+                sessions_.erase(work_host_index);
+            }
+            else
+            {
+                auto & session = sessions_[work_host_index];
+                
+                session.id = session_id;
+                session.extranonce1 = extranonce1;
+                session.extranonce2_size = extranonce2_size;
+            }
+        })
+    );
+}
+
+void work_manager::submit_work(const std::shared_ptr<stratum_work> & val)
+{
+    share_queue::share_t share;
+    
+    share.job_handle = val->job_handle();
+    share.extranonce2_size = static_cast<std::uint8_t> (
+        (std::min)(val->extranonce2().size(), sizeof(share.extranonce2))
+    );
+    
+    std::memcpy(
+        share.extranonce2, val->extranonce2().data(), share.extranonce2_size
+    );
+    
+    std::memset(share.time, 0, sizeof(share.time));
+    std::memcpy(
+        share.time, val->time().data(),
+        (std::min)(val->time().size(), sizeof(share.time))
+    );
+    
+    share.nonce = val->data()[19];
+    share.version = val->data()[0];
+    
+    /**
+     * If the queue is full let the io_service thread catch up.
+     */
+    auto tries = 0;
+    
+    while (share_queue_.push(share) == false)
+    {
+        post_drain_shares();
+        
+        if (++tries > 1000)
+        {
+            log_error("Work manager share queue is full, dropping share.");
+            
+            return;
+        }
+        
+        std::this_thread::yield();
+    }
+    
+    post_drain_shares();
+}
+
+bool work_manager::is_split()
+{
+    auto weighted = 0;
+    
+    for (auto & i : configuration::instance().work_host_weights())
+    {
+        if (i > 0.0)
+        {
+            weighted++;
+        }
+    }
+    
+    return weighted > 1;
+}
+
+std::shared_ptr<stratum_work> work_manager::split_work(
+    const std::map<std::uint32_t, std::shared_ptr<stratum_work> > & works,
+    const std::size_t & device, const std::size_t & devices
+    )
+{
+    const auto & weights = configuration::instance().work_host_weights();
+    
+    /**
+     * The weights of the work hosts that have work.
+     */
+    std::vector<std::pair<std::uint32_t, double> > candidates;
+    
+    auto total = 0.0;
+    
+    for (auto & i : works)
+    {
+        if (i.second && i.first < weights.size() && weights[i.first] > 0.0)
+        {
+            candidates.push_back(std::make_pair(i.first, weights[i.first]));
+            
+            total += weights[i.first];
+        }
+    }
+    
+    if (candidates.size() == 0)
+    {
+        /**
+         * None of the weighted work hosts have work, use any that does.
+         */
+        for (auto & i : works)
+        {
+            if (i.second)
+            {
+                return i.second;
+            }
+        }
+        
+        return std::shared_ptr<stratum_work> ();
+    }
+    
+    /**
+     * Assign the device by the middle of it's slice of the total weight
+     * (so that N devices divide as evenly as possible).
+     */
+    auto position =
+        (static_cast<double> (device) + 0.5) /
+        static_cast<double> ((std::max)(devices, std::size_t(1))) * total
+    ;
+    
+    for (auto & i : candidates)
+    {
+        if (position < i.second)
+        {
+            return works.at(i.first);
+        }
+        
+        position -= i.second;
+    }
+    
+    return works.at(candidates.back().first);
+}
+
+void work_manager::submit_share(
+    const share_queue::share_t & val,
+    const std::function<void (const bool &)> & f
+    )
+{
+    auto self(shared_from_this());
+    
+    stack_impl_.io_service().post(strand_.wrap(
+        [this, self, val, f] ()
+        {
+            if (send_share(val, f) == false)
+            {
+                f(false);
+            }
+        })
+    );
+}
+
+void work_manager::post_drain_shares()
+{
+    if (drain_shares_pending_.exchange(true) == false)
+    {
+        auto self(shared_from_this());
+        
+        stack_impl_.io_service().post(strand_.wrap(
+            [this, self] ()
+            {
+                drain_shares();
+            })
+        );
+    }
+}
+
+void work_manager::drain_shares()
+{
+    /**
+     * Clear the pending flag first so shares pushed while draining schedule
+     * another drain.
+     */
+    drain_shares_pending_ = false;
+    
+    /**
+     * The maximum number of shares per batch.
+     */
+    enum { batch_size = 64 };
+    
+    /**
+     * Update the statistics (once per batch).
+     */
+    stack_impl_.update_statistics();
+    
+    share_queue::share_t share;
+    
+    auto count = 0;
+    
+    while (count < batch_size && share_queue_.pop(share))
+    {
+        count++;
+        
+        send_share(share, std::function<void (const bool &)> ());
+    }
+    
+    /**
+     * If the batch was full yield to other handlers and continue later.
+     */
+    if (count == batch_size)
+    {
+        post_drain_shares();
+    }
+}
+
+bool work_manager::send_share(
+    const share_queue::share_t & val,
+    const std::function<void (const bool &)> & f
+    )
+{
+    std::shared_ptr<stratum_work> work;
+    
+    auto stale = false;
+    
+    auto duplicate = false;
+    
+    /**
+     * The (extranonce2, ntime, nonce) tuple of the share.
+     */
+    std::string share(
+        reinterpret_cast<const char *> (val.extranonce2),
+        val.extranonce2_size
+    );
+    
+    share.append(
+        reinterpret_cast<const char *> (val.time), sizeof(val.time)
+    );
+    share.append(
+        reinterpret_cast<const char *> (&val.nonce), sizeof(val.nonce)
+    );
+    
+    mutex_jobs_.lock();
+    
+    auto it = jobs_.find(val.job_handle);
+    
+    if (it != jobs_.end())
+    {
+        work = it->second;
+        
+        /**
+         * The job was invalidated by a work restart (clean jobs) of it's
+         * work host, the older jobs of the current generation are still
+         * valid.
+         */
+        stale =
+            work->generation() != generations_[work->work_host_index()]
+        ;
+        
+        if (stale == false)
+        {
+            auto it_submitted = submitted_.find(
+                std::make_tuple(
+                    work->work_host_index(), work->extranonce1(),
+                    work->job_id()
+                )
+            );
+            
+            if (it_submitted != submitted_.end())
+            {
+                duplicate = it_submitted->second.shares.count(share) > 0;
+            }
+        }
+    }
+    
+    mutex_jobs_.unlock();
+    
+    if (work == 0)
+    {
+        log_error(
+            "Work manager dropping share for unknown job handle " <<
+            val.job_handle << "."
+        );
+        
+        return false;
+    }
+    else if (stale)
+    {
+        const auto & work_host =
+            configuration::instance().work_hosts()[work->work_host_index()]
+        ;
+        
+        log_debug(
+            "Work manager dropping stale share for job " << work->job_id() <<
+            " of work host " << work->work_host_index() << "."
+        );
+        
+        statistics::instance().record_stale_drop(
+            work_host.second.first + ":" +
+            std::to_string(work_host.second.second)
+        );
+        
+        return false;
+    }
+    else if (duplicate)
+    {
+        log_debug(
+            "Work manager dropping duplicate share (nonce = " << val.nonce <<
+            ") for job " << work->job_id() << " of work host " <<
+            work->work_host_index() << "."
+        );
+        
+        return false;
+    }
+    
+    /**
+     * The share is submitted to the work host that issued the job.
+     */
+    std::shared_ptr<stratum_connection> connection;
+    
+    auto it_connection = stratum_connections_.find(
+        work->work_host_index()
+    );
+    
+    if (it_connection != stratum_connections_.end())
+    {
+        connection = it_connection->second.lock();
+    }
+    
+    if (connection == 0)
+    {
+        log_error(
+            "Work manager dropping share for disconnected work host " <<
+            work->work_host_index() << "."
+        );
+        
+        return false;
+    }
+    
+    stratum_connection::submit_t submit;
+    
+    submit.job_handle = val.job_handle;
+    submit.nonce = val.nonce;
+    submit.time_notified = work->time_notified();
+    submit.handler = f;
+    
+    /**
+     * A header-only job is submitted without the mining.submit template.
+     */
+    if (work->merkle_root().size() > 0)
+    {
+        connection->submit_header(val, work, submit);
+    }
+    else
+    {
+        const auto & submit_template = work->submit_template();
+        
+        if (
+            submit_template == 0 || submit_template->extranonce2_length !=
+            val.extranonce2_size * 2u
+            )
+        {
+            log_error(
+                "Work manager dropping share with invalid extranonce2 for "
+                "job handle " << val.job_handle << "."
+            );
+            
+            return false;
+        }
+        
+        std::uint32_t nonce_little = utility::le32dec(&val.nonce);
+        
+        /**
+         * Copy the template into a pooled buffer and patch the slots in
+         * place (the connection patches the id).
+         */
+        auto json_line = buffer_pool_.acquire();
+        
+        json_line->assign(submit_template->json);
+        
+        auto ptr = &(*json_line)[0];
+        
+        utility::to_hex(
+            val.extranonce2, val.extranonce2_size,
+            ptr + submit_template->extranonce2_offset
+        );
+        
+        utility::to_hex(
+            val.time, sizeof(val.time), ptr + submit_template->time_offset
+        );
+
+        utility::to_hex(
+            reinterpret_cast<std::uint8_t *> (&nonce_little),
+            sizeof(nonce_little), ptr + submit_template->nonce_offset
+        );
+        
+        connection->submit(json_line, submit_template->id_offset, submit);
+    }
+    
+    /**
+     * Only a share that was handed to the connection counts as submitted.
+     */
+    std::lock_guard<std::mutex> l1(mutex_jobs_);
+    
+    auto it_submitted = submitted_.find(
+        std::make_tuple(
+            work->work_host_index(), work->extranonce1(), work->job_id()
+        )
+    );
+    
+    if (it_submitted != submitted_.end())
+    {
+        it_submitted->second.shares.insert(share);
+    }
+    
+    return true;
+}
+
+void work_manager::connect(const std::uint32_t & work_host_index)
+{
+    log_info(
+        "Work manager is connecting to work host " << work_host_index << "."
+    );
+    
+    /**
+     * Allocate a stratum_connection (or stratum_v2_connection).
+     */
+    std::shared_ptr<stratum_connection> c;
+    
+    if (
+        configuration::instance().work_host_protocols()[work_host_index] ==
+        configuration::work_host_protocol_stratum_v2
+        )
+    {
+        c = std::make_shared<stratum_v2_connection> (
+            stack_impl_, work_host_index
+        );
+    }
+    else
+    {
+        c = std::make_shared<stratum_connection> (
+            stack_impl_, work_host_index
+        );
+    }
+    
+    /**
+     * Offer the previous session for resumption (once, it is set again if
+     * the work host subscribes).
+     */
+    auto it = sessions_.find(work_host_index);
+    
+    if (it != sessions_.end())
+    {
+        c->set_session(
+            it->second.id, it->second.extranonce1,
+            it->second.extranonce2_size
+        );
+        
+        sessions_.erase(it);
+    }
+    
+    /**
+     * Retain the stratum_connection.
+     */
+    stratum_connections_[work_host_index] = c;
+    
+    /**
+     * Start the stratum_connection.
+     */
+    c->start();
+}
+
+void work_manager::connect_work_hosts()
+{
+    const auto & work_hosts = configuration::instance().work_hosts();
+    
+    /**
+     * The current work host and the first N others are kept connected,
+     * when elected by latency the first N + 1 are so that the candidates
+     * do not change with the current one.
+     */
+    std::vector<bool> wanted(work_hosts.size(), false);
+    
+    wanted[work_host_index_] = true;
+    
+    std::uint32_t backups = 0;
+    
+    auto by_latency =
+        configuration::instance().pool_selection() ==
+        configuration::pool_selection_latency
+    ;
+    
+    for (
+        std::uint32_t i = 0; i < work_hosts.size() &&
+        backups < configuration::instance().backup_pools() +
+        (by_latency ? 1 : 0); i++
+        )
+    {
+        if (i != work_host_index_ || by_latency)
+        {
+            wanted[i] = true;
+            
+            backups++;
+        }
+    }
+    
+    /**
+     * When hashing is split every weighted work host is kept connected.
+     */
+    const auto & weights = configuration::instance().work_host_weights();
+    
+    if (is_split())
+    {
+        for (std::uint32_t i = 0; i < work_hosts.size(); i++)
+        {
+            if (i < weights.size() && weights[i] > 0.0)
+            {
+                wanted[i] = true;
+            }
+        }
+    }
+    
+    for (std::uint32_t i = 0; i < work_hosts.size(); i++)
+    {
+        std::shared_ptr<stratum_connection> connection;
+        
+        auto it = stratum_connections_.find(i);
+        
+        if (it != stratum_connections_.end())
+        {
+            connection = it->second.lock();
+        }
+        
+        if (wanted[i] && connection == 0)
+        {
+            connect(i);
+        }
+        else if (wanted[i] == false && connection)
+        {
+            log_info(
+                "Work manager is disconnecting (backup) work host " << i <<
+                "."
+            );
+            
+            connection->stop();
+        }
+    }
+}
+
+void work_manager::select_work_host(const std::uint32_t & work_host_index)
+{
+    work_host_index_ = work_host_index;
+    
+    log_info(
+        "Work manager is switching to " <<
+        (work_host_index_ == 0 ? "(primary)" : "(backup)") <<
+        " work host " << work_host_index_ << "."
+    );
+    
+    stratum::instance().set_host(
+        configuration::instance().work_hosts()[
+        work_host_index_].second.first
+    );
+    stratum::instance().set_port(
+        configuration::instance().work_hosts()[
+        work_host_index_].second.second
+    );
+    stratum::instance().set_username(
+        configuration::instance().work_hosts()[
+        work_host_index_].first.first
+    );
+    stratum::instance().set_password(
+        configuration::instance().work_hosts()[
+        work_host_index_].first.second
+    );
+}
+
+void work_manager::failover(const std::uint32_t & work_host_index)
 {
-    if (configuration::instance().work_hosts().size() > 0)
+    auto time_failed = std::chrono::steady_clock::now();
+    
+    /**
+     * The backups that are mining with cached work (by work host index or
+     * by measured latency).
+     */
+    std::vector<std::uint32_t> candidates;
+    
+    for (auto & i : works_)
+    {
+        if (
+            i.first != work_host_index && i.second && is_mining(i.first)
+            )
+        {
+            candidates.push_back(i.first);
+        }
+    }
+    
+    if (
+        configuration::instance().pool_selection() ==
+        configuration::pool_selection_latency
+        )
+    {
+        std::stable_sort(
+            candidates.begin(), candidates.end(),
+            [this](const std::uint32_t & a, const std::uint32_t & b)
+            {
+                return score(a) < score(b);
+            }
+        );
+    }
+    
+    if (candidates.size() > 0)
     {
         log_info(
-            "Work manager is switching to (primary) work host " <<
-            work_host_index_ << "."
+            "Work manager work host " << work_host_index <<
+            " disconnected, failing over."
         );
         
-        stratum::instance().set_host(
-            configuration::instance().work_hosts()[
-            work_host_index_].second.first
-        );
-        stratum::instance().set_port(
-            configuration::instance().work_hosts()[
-            work_host_index_].second.second
-        );
-        stratum::instance().set_username(
-            configuration::instance().work_hosts()[
-            work_host_index_].first.first
+        select_work_host(candidates.front());
+        
+        /**
+         * Copy the cached work so the devices measure the latency from the
+         * failure (instead of the notify) to the first hash.
+         */
+        auto work = std::make_shared<stratum_work> (
+            *works_[work_host_index_]
         );
-        stratum::instance().set_password(
-            configuration::instance().work_hosts()[
-            work_host_index_].first.second
+        
+        work->set_time_notified(time_failed);
+        
+        m_work = work;
+        
+        stack_impl_.handle_work(m_work);
+        
+        log_info(
+            "Work manager failed over to work host " << work_host_index_ <<
+            " in " << std::chrono::duration_cast<std::chrono::microseconds> (
+            std::chrono::steady_clock::now() - time_failed).count() <<
+            " microseconds."
         );
+        
+        /**
+         * Connect the next backup.
+         */
+        connect_work_hosts();
+        
+        return;
     }
-    else
+    
+    /**
+     * If the work host can resume it's session the current job stays valid
+     * so keep hashing it while reconnecting (the job is aborted if the
+     * resumption is rejected).
+     */
+    if (
+        m_work && m_work->work_host_index() == work_host_index &&
+        sessions_.count(work_host_index) > 0
+        )
     {
-        throw std::runtime_error("no work hosts");
+        log_info(
+            "Work manager work host " << work_host_index <<
+            " disconnected, resuming session."
+        );
+        
+        connect(work_host_index);
+        
+        return;
     }
     
-    timer_.expires_from_now(std::chrono::seconds(8));
-    timer_.async_wait(std::bind(
-        &work_manager::tick, this, std::placeholders::_1)
-    );
+    log_error("Work manager disconnected.");
+
+    /**
+     * Abort work.
+     */
+    m_work.reset();
+    
+    stack_impl_.handle_work(m_work);
     
     /**
-     * Connect to a work server.
+     * Try the next work host that did not fail it's last probe (or else
+     * the next one).
      */
-    connect();
+    auto next = work_host_index_;
+    
+    for (
+        auto i = work_host_index_ + 1;
+        i < configuration::instance().work_hosts().size(); i++
+        )
+    {
+        auto it = probes_.find(i);
+        
+        if (it == probes_.end() || it->second.success)
+        {
+            next = i;
+            
+            break;
+        }
+    }
+    
+    if (
+        next == work_host_index_ &&
+        configuration::instance().work_hosts().size() > work_host_index_ + 1
+        )
+    {
+        next = work_host_index_ + 1;
+    }
+    
+    if (next != work_host_index_)
+    {
+        select_work_host(next);
+        
+        /**
+         * Connect to a work server.
+         */
+        connect_work_hosts();
+    }
+    else
+    {
+        log_info(
+            "Work manager work host " << work_host_index_ <<
+            " is down, will retry."
+        );
+    }
 }
 
-void work_manager::stop()
+bool work_manager::is_mining(const std::uint32_t & work_host_index)
 {
-    timer_.cancel();
-    timer_check_work_hosts_.cancel();
+    auto it = stratum_connections_.find(work_host_index);
     
-    for (auto & i : stratum_connections_)
+    if (it != stratum_connections_.end())
     {
-        if (auto j = i.lock())
+        if (auto connection = it->second.lock())
         {
-            j->stop();
+            return connection->state() == stratum_connection::state_mining;
         }
     }
+    
+    return false;
 }
 
-void work_manager::set_work(const std::shared_ptr<stratum_work> & val)
+std::int64_t work_manager::score(const std::uint32_t & work_host_index)
 {
-    m_work = val;
+    auto it = latencies_.find(work_host_index);
     
-    auto self(shared_from_this());
+    if (it == latencies_.end() || it->second.rtt_samples == 0)
+    {
+        return std::numeric_limits<std::int64_t>::max();
+    }
     
-    stack_impl_.io_service().post(strand_.wrap(
-        [this, self] ()
-        {
-            stack_impl_.handle_work(m_work);
-        })
-    );
+    return it->second.rtt_subscribe + it->second.notify_delay;
 }
 
-void work_manager::submit_work(const std::shared_ptr<stratum_work> & val)
+void work_manager::record_latency(
+    const std::uint32_t & work_host_index, const stratum_probe::result_t & val
+    )
 {
+    auto & latency = latencies_[work_host_index];
+    
     /**
-     * Update the statistics.
+     * Smooth the samples (an exponentially weighted moving average).
      */
-    stack_impl_.update_statistics();
+    if (latency.rtt_samples == 0)
+    {
+        latency.rtt_connect = val.rtt_connect.count();
+        latency.rtt_subscribe = val.rtt_subscribe.count();
+    }
+    else
+    {
+        latency.rtt_connect +=
+            (val.rtt_connect.count() - latency.rtt_connect) / 4
+        ;
+        latency.rtt_subscribe +=
+            (val.rtt_subscribe.count() - latency.rtt_subscribe) / 4
+        ;
+    }
     
-    auto time = utility::to_hex(val->time());
+    latency.rtt_samples++;
     
-    std::uint32_t nonce_little = utility::le32dec(&val->data()[19]);
+    log_debug(
+        "Work manager work host " << work_host_index << " rtt connect = " <<
+        latency.rtt_connect << ", subscribe = " << latency.rtt_subscribe <<
+        " microseconds."
+    );
+}
 
-    auto nonce = utility::to_hex(
-        reinterpret_cast<std::uint8_t *>(&nonce_little),
-        reinterpret_cast<std::uint8_t *>(&nonce_little) + sizeof(std::uint32_t)
+void work_manager::record_notify(
+    const std::uint32_t & work_host_index,
+    const std::shared_ptr<stratum_work> & val
+    )
+{
+    auto it1 = previous_hashes_.find(work_host_index);
+    
+    /**
+     * Only the first notify of a new block is measured and not the first
+     * one after connecting (the block is not new).
+     */
+    if (
+        it1 != previous_hashes_.end() &&
+        it1->second == val->previous_hash()
+        )
+    {
+        return;
+    }
+    
+    auto is_first = it1 == previous_hashes_.end();
+    
+    previous_hashes_[work_host_index] = val->previous_hash();
+    
+    if (is_first)
+    {
+        return;
+    }
+    
+    /**
+     * Find when the block was first notified (by any work host).
+     */
+    auto it2 = std::find_if(
+        blocks_.begin(), blocks_.end(),
+        [&val](const std::pair<std::vector<std::uint8_t>,
+        std::chrono::steady_clock::time_point> & block)
+        {
+            return block.first == val->previous_hash();
+        }
     );
     
-    auto extranonce2 = utility::to_hex(val->extranonce2());
-
-    std::string json_line =
-        "{\"params\": [\"" + val->worker_name() +
-        "\", \"" + val->job_id() + "\", \"" + extranonce2 + "\", \"" + time +
-        "\", \"" + nonce + "\"], \"id\": 4, \"method\": \"mining.submit\"}\n"
-    ;
-
-    for (auto & i : stratum_connections_)
+    std::int64_t delay = 0;
+    
+    if (it2 == blocks_.end())
     {
-        if (auto j = i.lock())
+        blocks_.push_back(
+            std::make_pair(val->previous_hash(), val->time_notified())
+        );
+        
+        /**
+         * Only keep the recent blocks.
+         */
+        while (blocks_.size() > 16)
         {
-            j->write(json_line);
+            blocks_.pop_front();
         }
     }
+    else
+    {
+        delay = std::chrono::duration_cast<std::chrono::microseconds> (
+            val->time_notified() - it2->second
+        ).count();
+    }
+    
+    auto & latency = latencies_[work_host_index];
+    
+    if (latency.notify_samples == 0)
+    {
+        latency.notify_delay = delay;
+    }
+    else
+    {
+        latency.notify_delay += (delay - latency.notify_delay) / 4;
+    }
+    
+    latency.notify_samples++;
+    
+    log_debug(
+        "Work manager work host " << work_host_index << " notified block " <<
+        delay << " microseconds after the first, average = " <<
+        latency.notify_delay << " microseconds."
+    );
 }
 
-void work_manager::connect()
+void work_manager::elect_work_host()
 {
-    log_info("Work manager is connecting.");
-    
     /**
-     * Allocate a stratum_connection.
+     * Find the fastest work host that is mining.
      */
-    auto c = std::make_shared<stratum_connection> (stack_impl_);
+    auto best = work_host_index_;
     
-    /**
-     * Retain the stratum_connection.
-     */
-    stratum_connections_.push_back(c);
+    for (auto & i : works_)
+    {
+        if (i.second && is_mining(i.first) && score(i.first) < score(best))
+        {
+            best = i.first;
+        }
+    }
+    
+    auto current = score(work_host_index_);
+    auto candidate = score(best);
     
     /**
-     * Start the stratum_connection.
+     * The candidate must be faster by 20% (and 2 milliseconds) for 3
+     * consecutive checks (hysteresis).
      */
-    c->start();
+    if (
+        best == work_host_index_ || static_cast<double> (candidate) >
+        static_cast<double> (current) * 0.8 ||
+        static_cast<double> (candidate) + 2000.0 >
+        static_cast<double> (current)
+        )
+    {
+        election_count_ = 0;
+        
+        return;
+    }
+    
+    if (election_index_ == best)
+    {
+        election_count_++;
+    }
+    else
+    {
+        election_index_ = best;
+        election_count_ = 1;
+    }
+    
+    log_debug(
+        "Work manager work host " << best << " is faster (" << candidate <<
+        " < " << current << " microseconds), count = " << election_count_ <<
+        "."
+    );
+    
+    if (election_count_ >= 3)
+    {
+        election_count_ = 0;
+        
+        log_info(
+            "Work manager elected work host " << best << " (" << candidate <<
+            " < " << current << " microseconds)."
+        );
+        
+        select_work_host(best);
+        
+        m_work = works_[best];
+        
+        stack_impl_.handle_work(m_work);
+        
+        connect_work_hosts();
+    }
 }
 
 void work_manager::tick(const boost::system::error_code & ec)
@@ -172,113 +1302,42 @@ void work_manager::tick(const boost::system::error_code & ec)
     }
     else
     {
-        /**
-         * The timer timeout in seconds.
-         */
-        auto timeout = 8;
-        
-        /**
-         * If the connections are empty we need a reconnect.
-         */
-        bool needs_reconnect = stratum_connections_.size() == 0;
-        
         auto connections = 0;
         
-        for (auto & i : stratum_connections_)
-        {
-            if (auto j = i.lock())
-            {
-                connections++;
-            }
-        }
-        
-        log_debug("Work manager tick, connections = " << connections << ".");
+        auto it = stratum_connections_.begin();
         
-        if (needs_reconnect || connections == 0)
+        while (it != stratum_connections_.end())
         {
-            log_error("Work manager disconnected.");
-
-            /**
-             * Abort work.
-             */
-            set_work(0);
-
-            /**
-             * Try to set a backup work hosts if possible.
-             */
-            if (
-                configuration::instance().work_hosts().size() >
-                work_host_index_ + 1
-                )
+            if (auto connection = it->second.lock())
             {
-                /**
-                 * Increment the work index.
-                 */
-                ++work_host_index_;
-                
-                log_info(
-                    "Work manager is switching to (backup) work host " <<
-                    work_host_index_ << "."
-                );
+                connections++;
                 
                 /**
-                 * Start the check work hosts timer.
+                 * Keep the share rate near the configured one.
                  */
-                timer_check_work_hosts_.expires_from_now(
-                    std::chrono::seconds(60)
-                );
-                timer_check_work_hosts_.async_wait(std::bind(
-                    &work_manager::tick_check_work_hosts, this,
-                    std::placeholders::_1)
-                );
+                connection->suggest_difficulty();
                 
-                stratum::instance().set_host(
-                    configuration::instance().work_hosts()[
-                    work_host_index_].second.first
-                );
-                stratum::instance().set_port(
-                    configuration::instance().work_hosts()[
-                    work_host_index_].second.second
-                );
-                stratum::instance().set_username(
-                    configuration::instance().work_hosts()[
-                    work_host_index_].first.first
-                );
-                stratum::instance().set_password(
-                    configuration::instance().work_hosts()[
-                    work_host_index_].first.second
-                );
-        
-                /**
-                 * Connect to a work server.
-                 */
-                connect();
+                ++it;
             }
             else
             {
-                log_info(
-                    "Work manager (primary) work host " <<
-                    work_host_index_ << " is down, will retry."
-                );
-                
-                /**
-                 * Start the check work hosts timer.
-                 */
-                timer_check_work_hosts_.expires_from_now(
-                    std::chrono::seconds(60)
-                );
-                timer_check_work_hosts_.async_wait(std::bind(
-                    &work_manager::tick_check_work_hosts, this,
-                    std::placeholders::_1)
-                );
+                it = stratum_connections_.erase(it);
             }
-            
-            /**
-             * Set the timeout to N to allow for work host check to complete.
-             */
-            timeout = 90;
-            
-            assert(timeout > 60);
+        }
+        
+        log_debug("Work manager tick, connections = " << connections << ".");
+        
+        /**
+         * Reconnect the current and backup work hosts that are down.
+         */
+        connect_work_hosts();
+        
+        if (
+            is_split() == false && configuration::instance(
+            ).pool_selection() == configuration::pool_selection_latency
+            )
+        {
+            elect_work_host();
         }
 
         /**
@@ -286,9 +1345,9 @@ void work_manager::tick(const boost::system::error_code & ec)
          */
         stack_impl_.update_statistics();
     
-        timer_.expires_from_now(std::chrono::seconds(timeout));
-        timer_.async_wait(std::bind(
-            &work_manager::tick, this, std::placeholders::_1)
+        timer_.expires_from_now(std::chrono::seconds(8));
+        timer_.async_wait(strand_.wrap(std::bind(
+            &work_manager::tick, this, std::placeholders::_1))
         );
     }
 }
@@ -301,87 +1360,50 @@ void work_manager::tick_check_work_hosts(const boost::system::error_code & ec)
     }
     else
     {
-        boost::asio::ip::tcp::iostream tcp_stream;
-        
         /**
-         * Check connectivity.
+         * Probe the work hosts that are not connected (or being probed).
          */
-        tcp_stream.connect(
-            configuration::instance().work_hosts()[0].second.first,
-            std::to_string(configuration::instance().work_hosts()[
-            0].second.second)
-        );
-        
-        if (!tcp_stream || tcp_stream.error())
+        for (
+            std::uint32_t i = 0;
+            i < configuration::instance().work_hosts().size(); i++
+            )
         {
-            log_info(
-                "Work manager (primary) work host check failed, will retry."
-            );
+            auto it1 = stratum_connections_.find(i);
             
-            /**
-             * Start the check work hosts timer.
-             */
-            timer_check_work_hosts_.expires_from_now(
-                std::chrono::seconds(60)
-            );
-            timer_check_work_hosts_.async_wait(std::bind(
-                &work_manager::tick_check_work_hosts, this,
-                std::placeholders::_1)
-            );
-        }
-        else
-        {
-            log_info(
-                "Work manager (primary) work host check success."
-            );
+            if (it1 != stratum_connections_.end() && it1->second.lock())
+            {
+                continue;
+            }
             
             /**
-             * Close the boost::asio::ip::tcp::iostream.
+             * The probe is a (stratum v1) mining.subscribe.
              */
-            tcp_stream.close();
+            if (
+                configuration::instance().work_host_protocols()[i] ==
+                configuration::work_host_protocol_stratum_v2
+                )
+            {
+                continue;
+            }
             
-            /**
-             * Disconnect all backup work hosts.
-             */
-            for (auto & i : stratum_connections_)
+            auto it2 = stratum_probes_.find(i);
+            
+            if (it2 != stratum_probes_.end() && it2->second.lock())
             {
-                if (auto j = i.lock())
-                {
-                    j->stop();
-                }
+                continue;
             }
             
-            /**
-             * Reset the work index.
-             */
-            work_host_index_ = 0;
-        
-            log_info(
-                "Work manager is switching to (primary) work host " <<
-                work_host_index_ << "."
-            );
-
-            stratum::instance().set_host(
-                configuration::instance().work_hosts()[
-                work_host_index_].second.first
-            );
-            stratum::instance().set_port(
-                configuration::instance().work_hosts()[
-                work_host_index_].second.second
-            );
-            stratum::instance().set_username(
-                configuration::instance().work_hosts()[
-                work_host_index_].first.first
-            );
-            stratum::instance().set_password(
-                configuration::instance().work_hosts()[
-                work_host_index_].first.second
-            );
-    
-            /**
-             * Connect to a work server.
-             */
-            connect();
+            auto probe = std::make_shared<stratum_probe> (stack_impl_, i);
+            
+            stratum_probes_[i] = probe;
+            
+            probe->start();
         }
+        
+        timer_check_work_hosts_.expires_from_now(std::chrono::seconds(60));
+        timer_check_work_hosts_.async_wait(strand_.wrap(std::bind(
+            &work_manager::tick_check_work_hosts, this,
+            std::placeholders::_1))
+        );
     }
 }
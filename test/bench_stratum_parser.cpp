@@ -0,0 +1,344 @@
+/*
+ * Copyright (c) 2013-2015 John Connor (BM-NC49AxAjcqVcF5jNPu85Rb8MJ2d9JqZt)
+ *
+ * This file is part of MinerPP.
+ *
+ * MinerPP is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License with
+ * additional permissions to the one published by the Free Software
+ * Foundation, either version 3 of the License, or (at your option)
+ * any later version. For more information see LICENSE.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ *
+ * You should have received a copy of the GNU Affero General Public License
+ * along with this program. If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <boost/property_tree/json_parser.hpp>
+
+#include <miner/stratum_parser.hpp>
+#include <miner/utility.hpp>
+
+using namespace miner;
+
+/**
+ * The recorded lines (a mining.notify with a merkle branch, a
+ * mining.submit result and a mining.submit error).
+ */
+static const char * g_lines[] =
+{
+    "{\"id\": null, \"method\": \"mining.notify\", \"params\": [\"58af8d8c\", "
+    "\"975b9717f7d18ec1f2ad55e2559b5997b8da0e3317c803780000000100000000\", "
+    "\"01000000010000000000000000000000000000000000000000000000000000000000"
+    "000000ffffffff4803636004062f503253482f04428b055308\", "
+    "\"2e522cfabe6d6da0bd01f57abe963d25879583eea5ea6f08f83e3327c83c6c4c9e9a"
+    "e5ffffffff0100f2052a010000001976a914b9ba06e4b7bb19c7b24d0d0d2e3b3f10c"
+    "b6ab0e388ac00000000\", [\"57351e8569cb9d036187a79fd1844fd930c1309efcd16"
+    "c46af9bb9713b6ee734\", \"936ab9c33420f187acae660fcdb07ffdffa081273674f0f"
+    "41e6ecc1347451d23\"], \"00000002\", \"1b44dfdb\", \"53058b41\", false]}",
+    "{\"id\": 7, \"result\": true, \"error\": null}",
+    "{\"id\": 8, \"result\": null, \"error\": [21, \"Stale share\", null]}",
+};
+
+/**
+ * The number of recorded lines.
+ */
+static const std::size_t g_lines_count = sizeof(g_lines) / sizeof(g_lines[0]);
+
+/**
+ * Parses a line through the stratum_parser (as the stratum_connection
+ * does).
+ * @param parser The stratum_parser.
+ * @param line The line.
+ * @param fields The (reused) decoded fields.
+ * @return The number of fields decoded.
+ */
+static std::size_t parse_tokenizer(
+    stratum_parser & parser, const std::string & line,
+    std::vector< std::vector<std::uint8_t> > & fields
+    )
+{
+    std::size_t ret = 0;
+    
+    if (parser.parse(line.data(), line.size()) == false)
+    {
+        return ret;
+    }
+    
+    auto method = parser.find(0, "method");
+    auto params = parser.find(0, "params");
+    auto result = parser.find(0, "result");
+    auto error = parser.find(0, "error");
+    auto id = parser.find(0, "id");
+    
+    if (method >= 0 && parser.equals(method, "mining.notify"))
+    {
+        for (std::size_t i = 0; i < parser.count(params); i++)
+        {
+            auto index = parser.at(params, i);
+            
+            if (parser.is_array(index))
+            {
+                for (std::size_t j = 0; j < parser.count(index); j++)
+                {
+                    ret += parser.to_bytes(
+                        parser.at(index, j), fields[ret % fields.size()]
+                    );
+                }
+            }
+            else if (i < 8)
+            {
+                ret += parser.to_bytes(index, fields[ret % fields.size()]);
+            }
+            else
+            {
+                ret += parser.to_bool(index);
+            }
+        }
+    }
+    else if (id >= 0 && parser.is_null(id) == false)
+    {
+        ret += parser.to_uint64(id) > 0;
+        
+        if (parser.is_null(error))
+        {
+            ret += parser.to_bool(result);
+        }
+        else
+        {
+            ret += parser.to_uint64(parser.at(error, 0)) > 0;
+            ret += parser.to_string(parser.at(error, 1)).size() > 0;
+        }
+    }
+    
+    return ret;
+}
+
+/**
+ * Parses a line through boost::property_tree (as the stratum_connection
+ * did before the stratum_parser).
+ * @param line The line.
+ * @return The number of fields decoded.
+ */
+static std::size_t parse_property_tree(const std::string & line)
+{
+    std::size_t ret = 0;
+    
+    boost::property_tree::ptree pt;
+    
+    try
+    {
+        std::stringstream ss;
+        
+        ss << line;
+        
+        read_json(ss, pt);
+    }
+    catch (std::exception & e)
+    {
+        return ret;
+    }
+    
+    std::string method;
+    
+    try
+    {
+        method = pt.get_child("method").get<std::string> ("");
+    }
+    catch (std::exception & e)
+    {
+        // ...
+    }
+    
+    boost::property_tree::ptree params;
+    
+    try
+    {
+        params = pt.get_child("params");
+    }
+    catch (std::exception & e)
+    {
+        // ...
+    }
+    
+    boost::property_tree::ptree result;
+    
+    try
+    {
+        result = pt.get_child("result");
+    }
+    catch (std::exception & e)
+    {
+        // ...
+    }
+    
+    boost::property_tree::ptree error;
+    
+    try
+    {
+        error = pt.get_child("error");
+    }
+    catch (std::exception & e)
+    {
+        // ...
+    }
+    
+    auto id = pt.get_child("id").get<std::string> ("");
+    
+    if (method == "mining.notify")
+    {
+        auto index = 0;
+        
+        for (auto & i : params)
+        {
+            if (i.second.size() > 0)
+            {
+                for (auto & j : i.second)
+                {
+                    ret += utility::from_hex(
+                        j.second.get<std::string> ("")).size() > 0
+                    ;
+                }
+            }
+            else if (index < 8)
+            {
+                ret += utility::from_hex(
+                    i.second.get<std::string> ("")).size() > 0
+                ;
+            }
+            else
+            {
+                ret += i.second.get<bool> ("");
+            }
+            
+            index++;
+        }
+    }
+    else if (id.size() > 0 && id != "null")
+    {
+        ret += std::stoul(id) > 0;
+        
+        if (error.size() == 0)
+        {
+            ret += result.get<bool> ("");
+        }
+        else
+        {
+            auto it = error.begin();
+            
+            ret += (it++)->second.get<std::int32_t> ("") > 0;
+            ret += it->second.get<std::string> ("").size() > 0;
+        }
+    }
+    
+    return ret;
+}
+
+/**
+ * Runs a parse function over the recorded lines and prints the lines per
+ * second.
+ * @param name The name.
+ * @param iterations The number of iterations.
+ * @param f The function.
+ */
+template <class T>
+static std::size_t run(
+    const char * name, const std::size_t & iterations, T f
+    )
+{
+    std::vector<std::string> lines(g_lines, g_lines + g_lines_count);
+    
+    std::size_t ret = 0;
+    
+    auto time1 = std::chrono::steady_clock::now();
+    
+    for (std::size_t i = 0; i < iterations; i++)
+    {
+        for (auto & j : lines)
+        {
+            ret += f(j);
+        }
+    }
+    
+    auto microseconds = std::chrono::duration_cast<
+        std::chrono::microseconds> (
+        std::chrono::steady_clock::now() - time1
+    ).count();
+    
+    std::cout <<
+        std::setw(14) << std::left << name << std::right <<
+        std::setw(10) << iterations * lines.size() << " lines, " <<
+        std::fixed << std::setprecision(3) << std::setw(10) <<
+        microseconds / 1000.0 << " ms, " << std::setprecision(0) <<
+        std::setw(10) << (microseconds > 0 ?
+        1000000.0 * iterations * lines.size() / microseconds : 0.0) <<
+        " lines/s, " << ret << " fields." << std::endl
+    ;
+    
+    return ret;
+}
+
+int main(int argc, const char * argv[])
+{
+    /**
+     * The number of iterations (over all recorded lines).
+     */
+    std::size_t iterations = argc > 1 ? std::strtoul(argv[1], 0, 10) : 100000;
+    
+    /**
+     * The property_tree path is about ten times slower.
+     */
+    std::size_t iterations_property_tree = iterations / 10 > 0 ?
+        iterations / 10 : 1
+    ;
+    
+    if (iterations == 0)
+    {
+        return 1;
+    }
+    
+    stratum_parser parser;
+    
+    std::vector< std::vector<std::uint8_t> > fields(8);
+    
+    auto tokenizer = run("tokenizer", iterations,
+        [&parser, &fields] (const std::string & line)
+        {
+            return parse_tokenizer(parser, line, fields);
+        }
+    );
+    
+    auto property_tree = run("property_tree", iterations_property_tree,
+        [] (const std::string & line)
+        {
+            return parse_property_tree(line);
+        }
+    );
+    
+    /**
+     * Both paths must decode the same fields.
+     */
+    if (
+        tokenizer / iterations != property_tree / iterations_property_tree
+        )
+    {
+        std::cerr << "Field count mismatch." << std::endl;
+        
+        return 1;
+    }
+    
+    return 0;
+}